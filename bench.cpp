@@ -0,0 +1,333 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "simulator.hpp"
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+#ifndef BENCH_FLAGS
+#define BENCH_FLAGS "unknown"
+#endif
+
+// Benchmarks the simulator itself (make bench). Generates packed synthetic
+// traces for a few sharing patterns, then times each one in a fresh child
+// process, so every row has its own peak RSS:
+//   stream             each core reads through its own array, writing one word in four
+//   random             uniform reads and writes over a shared 16 MB region
+//   producer-consumer  core 0 writes a 32 KB ring that the other cores read behind it
+//   false-sharing      every core writes its own word of the same few blocks
+//   migratory          cores read-modify-write shared objects in turn, between private work
+// Results are appended as CSV rows, one per pattern and size, tagged with
+// the source version and build flags, so runs of different versions can be
+// compared.
+
+static const char *const PATTERNS[] = {"stream", "random", "producer-consumer", "false-sharing", "migratory"};
+
+// splitmix64, so traces are the same on every host
+static uint64_t nextRandom(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static TraceRef generateRef(const std::string &pattern, int core, uint64_t i, uint64_t &rng)
+{
+    TraceRef ref;
+    ref.op = 'R';
+    if (pattern == "stream")
+    {
+        // 64 MB per core, wrapping
+        ref.addr = 0x10000000 + ((uint32_t)core << 26) + (uint32_t)((i * 4) & ((1 << 26) - 1));
+        ref.op = i % 4 == 3 ? 'W' : 'R';
+    }
+    else if (pattern == "random")
+    {
+        uint64_t r = nextRandom(rng);
+        ref.addr = 0x20000000 + (uint32_t)((r >> 8) & ((1 << 24) - 4));
+        ref.op = r % 10 < 3 ? 'W' : 'R';
+    }
+    else if (pattern == "producer-consumer")
+    {
+        uint32_t offset = (uint32_t)((i * 4) & ((32 << 10) - 1));
+        ref.addr = 0x30000000 + offset;
+        if (core == 0)
+            ref.op = 'W';
+        // Consumers also touch private data between buffer reads
+        else if (i % 2)
+            ref.addr = 0x38000000 + ((uint32_t)core << 20) + (uint32_t)((i * 4) & 0xfff);
+    }
+    else if (pattern == "false-sharing")
+    {
+        ref.addr = 0x40000000 + (uint32_t)(i % 16) * 64 + (uint32_t)(core % 16) * 4;
+        ref.op = i % 2 ? 'W' : 'R';
+    }
+    else
+    {
+        // Eight steps per object: read it, write it, then private work
+        uint64_t step = i % 8;
+        uint64_t object = (i / 8 + (uint64_t)core * 7) % 256;
+        if (step == 0 || step == 1)
+        {
+            ref.addr = 0x50000000 + (uint32_t)object * 64;
+            ref.op = step == 1 ? 'W' : 'R';
+        }
+        else
+        {
+            ref.addr = 0x58000000 + ((uint32_t)core << 20) + (uint32_t)((nextRandom(rng) >> 8) & 0x3ffc);
+        }
+    }
+    return ref;
+}
+
+static bool fileExists(const std::string &name)
+{
+    struct stat st;
+    return stat(name.c_str(), &st) == 0;
+}
+
+// Write <prefix>_procN.btrace for every core unless they already exist
+static bool generateTraces(const std::string &pattern, const std::string &prefix, int cores, uint64_t refs)
+{
+    uint64_t per_core = refs / cores;
+    for (int core = 0; core < cores; ++core)
+    {
+        std::string name = binaryTraceFileName(prefix, core);
+        if (fileExists(name))
+            continue;
+        BinaryTraceWriter writer;
+        std::string partial = name + ".tmp";
+        if (!writer.open(partial))
+            return false;
+        uint64_t rng = 1 + core;
+        for (uint64_t i = 0; i < per_core; ++i)
+            writer.add(generateRef(pattern, core, i, rng));
+        if (!writer.close() || rename(partial.c_str(), name.c_str()) != 0)
+            return false;
+    }
+    return true;
+}
+
+struct BenchResult {
+    double load_seconds = 0;
+    double simulate_seconds = 0;
+    uint64_t references = 0;
+    uint64_t cycles = 0;
+    uint64_t misses = 0;
+};
+
+// Runs in the child: load and simulate, and write the result to fd
+static int runCase(const SimulatorConfig &config, const std::string &prefix, int fd)
+{
+    typedef std::chrono::steady_clock Clock;
+    BenchResult result;
+    Clock::time_point start = Clock::now();
+    Simulator sim(config);
+    if (!sim.openTraces(prefix))
+        return 1;
+    Clock::time_point loaded = Clock::now();
+    sim.run();
+    Clock::time_point done = Clock::now();
+
+    result.load_seconds = std::chrono::duration<double>(loaded - start).count();
+    result.simulate_seconds = std::chrono::duration<double>(done - loaded).count();
+    for (int i = 0; i < sim.num_cores; ++i)
+    {
+        result.references += sim.caches[i].read_count + sim.caches[i].write_count;
+        result.misses += sim.caches[i].miss_count;
+    }
+    result.cycles = sim.global_stats.total_cycles;
+    return write(fd, &result, sizeof(result)) == (ssize_t)sizeof(result) ? 0 : 1;
+}
+
+// Fork a child per case; its rusage gives the peak RSS of that case alone
+static bool benchCase(const SimulatorConfig &config, const std::string &prefix, BenchResult &result, long &peak_rss_kb)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return false;
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+    if (pid == 0)
+    {
+        close(fds[0]);
+        _exit(runCase(config, prefix, fds[1]));
+    }
+    close(fds[1]);
+    bool ok = read(fds[0], &result, sizeof(result)) == (ssize_t)sizeof(result);
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return false;
+    peak_rss_kb = usage.ru_maxrss;
+    return ok;
+}
+
+static bool splitList(const char *arg, std::vector<std::string> &items)
+{
+    items.clear();
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item.empty())
+            return false;
+        items.push_back(item);
+    }
+    return !items.empty();
+}
+
+int main(int argc, char *argv[])
+{
+    SimulatorConfig config;
+    config.set_index_bits = 6;
+    config.assoc = 2;
+    config.block_bits = 5;
+    std::string dir = "bench_traces";
+    std::string outname = "bench_results.csv";
+    std::vector<std::string> sizes = {"1e5", "1e6"};
+    std::vector<std::string> patterns(PATTERNS, PATTERNS + sizeof(PATTERNS) / sizeof(PATTERNS[0]));
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:w:p:s:E:b:o:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'n':
+            if (!splitList(optarg, sizes))
+            {
+                std::cerr << "Invalid size list " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case 'w':
+            if (!splitList(optarg, patterns))
+            {
+                std::cerr << "Invalid pattern list " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case 'p':
+            config.num_cores = atoi(optarg);
+            if (config.num_cores < 1 || config.num_cores > MAX_CORES)
+            {
+                std::cerr << "Number of cores must be between 1 and " << MAX_CORES << "\n";
+                return 1;
+            }
+            break;
+        case 's':
+            config.set_index_bits = atoi(optarg);
+            break;
+        case 'E':
+            config.assoc = atoi(optarg);
+            break;
+        case 'b':
+            config.block_bits = atoi(optarg);
+            break;
+        case 'o':
+            outname = optarg;
+            break;
+        case 'h':
+            std::cout << "./l1bench [-d <trace dir>] [-n <sizes, e.g. 1e5,1e6>] [-w <patterns>] [-p <cores>] [-s <set_index_bits>] "
+                         "[-E <associativity>] [-b <block_bits>] [-o <results.csv>]\n"
+                         "Patterns: stream, random, producer-consumer, false-sharing, migratory\n";
+            return 0;
+        default:
+            std::cerr << "Invalid option\n";
+            return 1;
+        }
+    }
+
+    for (const std::string &pattern : patterns)
+    {
+        bool known = false;
+        for (const char *name : PATTERNS)
+            known |= pattern == name;
+        if (!known)
+        {
+            std::cerr << "Unknown pattern " << pattern << "\n";
+            return 1;
+        }
+    }
+    std::vector<uint64_t> refs;
+    for (const std::string &size : sizes)
+    {
+        char *end;
+        double value = strtod(size.c_str(), &end);
+        if (*end || value < config.num_cores || value > 1e12)
+        {
+            std::cerr << "Invalid size " << size << "\n";
+            return 1;
+        }
+        refs.push_back((uint64_t)value);
+    }
+    mkdir(dir.c_str(), 0755);
+
+    bool new_file = !fileExists(outname);
+    std::ofstream out(outname, std::ios::app);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << outname << "\n";
+        return 1;
+    }
+    if (new_file)
+        out << "version,flags,date,pattern,cores,references,set_index_bits,assoc,block_bits,load_seconds,simulate_seconds,"
+               "references_per_second,peak_rss_kb,cycles,misses\n";
+
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    std::cout << std::left << std::setw(18) << "pattern" << std::right << std::setw(12) << "refs" << std::setw(10) << "load s"
+              << std::setw(10) << "sim s" << std::setw(14) << "refs/s" << std::setw(12) << "peak KB" << "\n";
+    for (const std::string &pattern : patterns)
+    {
+        for (uint64_t n : refs)
+        {
+            std::string prefix = dir + "/" + pattern + "_" + std::to_string(n) + "_p" + std::to_string(config.num_cores);
+            if (!generateTraces(pattern, prefix, config.num_cores, n))
+            {
+                std::cerr << "Cannot write traces for " << prefix << "\n";
+                return 1;
+            }
+            BenchResult result;
+            long peak_rss_kb = 0;
+            if (!benchCase(config, prefix, result, peak_rss_kb))
+            {
+                std::cerr << "Benchmark " << prefix << " failed\n";
+                return 1;
+            }
+            double rate = result.simulate_seconds > 0 ? result.references / result.simulate_seconds : 0;
+            out << BENCH_VERSION << ",\"" << BENCH_FLAGS << "\"," << date << "," << pattern << "," << config.num_cores << "," << result.references << ","
+                << config.set_index_bits << "," << config.assoc << "," << config.block_bits << ","
+                << std::fixed << std::setprecision(6) << result.load_seconds << "," << result.simulate_seconds << ","
+                << std::setprecision(0) << rate << "," << peak_rss_kb << "," << result.cycles << "," << result.misses << "\n";
+            out.flush();
+            std::cout << std::left << std::setw(18) << pattern << std::right << std::setw(12) << result.references
+                      << std::fixed << std::setprecision(3) << std::setw(10) << result.load_seconds << std::setw(10)
+                      << result.simulate_seconds << std::setprecision(0) << std::setw(14) << rate << std::setw(12) << peak_rss_kb
+                      << "\n";
+        }
+    }
+    std::cout << "Results appended to " << outname << "\n";
+    return 0;
+}
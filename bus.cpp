@@ -1,151 +1,263 @@
-#include "bus.hpp"
+#include "simulator.hpp"
+#include "replacement.hpp"
 #include <iostream>
+#include <cstring>
 
-std::queue<BusRequest> bus_queue;
-int bus_busy_cycles = 0;
-int current_initiator = -1;
-int bus_transactions = 0;  // Global counter for bus transactions
+bool parseBusMode(const char *name, BusMode &mode)
+{
+    if (strcmp(name, "blocking") == 0)
+        mode = BUS_BLOCKING;
+    else if (strcmp(name, "split") == 0)
+        mode = BUS_SPLIT;
+    else
+        return false;
+    return true;
+}
+
+bool parseBusArbitration(const char *name, BusArbitration &arbitration)
+{
+    if (strcmp(name, "fifo") == 0)
+        arbitration = ARBITRATION_FIFO;
+    else if (strcmp(name, "rr") == 0 || strcmp(name, "round-robin") == 0)
+        arbitration = ARBITRATION_ROUND_ROBIN;
+    else if (strcmp(name, "priority") == 0)
+        arbitration = ARBITRATION_PRIORITY;
+    else
+        return false;
+    return true;
+}
+
+const char *busArbitrationName(BusArbitration arbitration)
+{
+    switch (arbitration)
+    {
+    case ARBITRATION_FIFO:
+        return "FIFO";
+    case ARBITRATION_ROUND_ROBIN:
+        return "round-robin";
+    case ARBITRATION_PRIORITY:
+        return "fixed priority";
+    }
+    return "unknown";
+}
+
+BusRequest BusArbiter::grant()
+{
+    size_t pick = 0;
+    if (policy == ARBITRATION_ROUND_ROBIN)
+    {
+        // Distance from the last granted core, wrapping around
+        int best = MAX_CORES + 1;
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            int distance = (pending[i].core - last_granted - 1 + MAX_CORES) % MAX_CORES;
+            if (distance < best)
+            {
+                best = distance;
+                pick = i;
+            }
+        }
+    }
+    else if (policy == ARBITRATION_PRIORITY)
+    {
+        for (size_t i = 1; i < pending.size(); ++i)
+        {
+            if (pending[i].core < pending[pick].core)
+                pick = i;
+        }
+    }
+    BusRequest req = pending[pick];
+    pending.erase(pending.begin() + pick);
+    last_granted = req.core;
+    return req;
+}
+
+// Write a dirty block back below the L1s. Returns the cycles the transfer
+// holds the bus and the writing cache: the whole write on the blocking bus,
+// only the data phase on the split bus, where memory absorbs the write.
+static uint32_t writeBackOnBus(Simulator &sim, uint32_t addr)
+{
+    uint32_t latency = writeBackBlock(sim, addr);
+    if (sim.config.bus.mode == BUS_SPLIT)
+        latency = 2 * (sim.caches[0].block_size / 4);
+    sim.global_stats.writeback_cycles += latency;
+    return latency;
+}
+
+// Keep a snooped cache busy supplying or writing back the block. A core
+// queued on the split bus (stall -1) idles until its grant anyway, so the
+// work overlaps the wait and the core stays queued rather than issuing
+// again before its request is granted.
+static void keepSnooperBusy(Cache &cache, int cycles)
+{
+    if (cache.stall_cycles >= 0)
+        cache.stall_cycles += cycles;
+}
 
 // Process snooping for other caches
-void snoopBus(int initiator_core, uint32_t addr, bool is_write, bool &shared, bool &supplied)
+template <class Geometry>
+void snoopBus(Simulator &sim, int initiator_core, uint32_t addr, bool is_write, bool &shared, bool &supplied)
 {
+    PROFILE_SCOPE(PHASE_SNOOP);
+    PROFILE_COUNT(COUNT_SNOOPS);
     // bus_transactions++;  // Increment bus transactions counter
     uint32_t tag, set_index, block_offset;
-    parseAddress(addr, caches[0].set_index_bits, caches[0].block_offset_bits, tag, set_index, block_offset);
+    Geometry::split(sim.caches[0], addr, tag, set_index, block_offset);
 
     supplied = false;
+    bool requester_holds = shared; // an upgrade: the requester has the data already
     bool caused_invalidation = false; // Track if this transaction caused any invalidations
 
-    for (int i = 0; i < 4; ++i)
+    // Visit only the other caches the filter says hold the block, in core order
+    sim.snoop_filter.lookups++;
+    uint32_t block = addr >> Geometry::blockOffsetBits(sim.caches[0]);
+    uint64_t holders = sim.snoop_filter.lookup(block) & ~(1ULL << initiator_core);
+    if (sim.sharing && is_write && requester_holds)
+        recordSharingAccess(*sim.sharing, initiator_core, addr, true, false, false);
+    while (holders)
     {
-        if (i == initiator_core)
+        int i = __builtin_ctzll(holders);
+        holders &= holders - 1;
+        sim.snoop_filter.probes++;
+        Cache &cache = sim.caches[i];
+        int way = Geometry::findLine(cache, set_index, tag);
+        if (way < 0)
             continue;
-        Cache &cache = caches[i];
-        auto &set = cache.sets[set_index];
+        uint8_t &state = cache.states[Geometry::line(cache, set_index, way)];
+        const ProtocolTable &protocol = *sim.protocol;
+        const SnoopResponse &response = !is_write ? protocol.read[state] : requester_holds ? protocol.upgrade[state] : protocol.write[state];
 
-        for (auto &line : set)
+        if (is_write)
         {
-            if (line.state != INVALID && line.tag == tag)
+            // comes from write hit at a shared copy, or write miss
+            // Write: Invalidate other copies, writing dirty ones back to memory
+            if (response.write_back)
             {
-                if (is_write)
-                {
-                    // comes from write hit at SHARED, or write miss
-                    // Write: Invalidate other copies
-                    if (line.state == MODIFIED)
-                    {
-                        // Write back to memory
-                        global_stats.bus_data_traffic += cache.block_size;
-                        caches[initiator_core].data_traffic += cache.block_size; // Track data traffic for initiator core
-                        bus_busy_cycles += 100;
-                        cache.stall_cycles += 100 - 1;
-                        cache.writeback_count++;
-                        line.state = INVALID;
-                        global_stats.invalidations++;
-                        caused_invalidation = true;
-                    }
-                    else
-                    {
-                        line.state = INVALID;
-                        global_stats.invalidations++;
-                        caused_invalidation = true;
-                    }
-                    // For write misses, we don't do cache-to-cache transfers
-                    // The initiating core will get the data from memory and modify it
-                    // We just need to invalidate any copies in other caches
-                }
-                else
+                sim.global_stats.bus_data_traffic += cache.block_size;
+                sim.caches[initiator_core].data_traffic += cache.block_size; // Track data traffic for initiator core
+                uint32_t latency = writeBackOnBus(sim, addr);
+                sim.bus_busy_cycles += latency;
+                keepSnooperBusy(cache, latency - 1);
+                cache.writeback_count++;
+            }
+            state = response.next;
+            sim.snoop_filter.remove(block, i);
+            if (sim.sharing)
+                recordSharingInvalidation(*sim.sharing, block);
+            sim.global_stats.invalidations++;
+            caused_invalidation = true;
+            // For write misses, we don't do cache-to-cache transfers
+            // The initiating core will get the data from memory and modify it
+            // We just need to invalidate any copies in other caches
+        }
+        else
+        {
+            // comes from read miss
+            // Read: the copies the protocol names supply the data, all update their state
+            if (response.supply)
+            {
+                // data gets copied to target cache; the first supplier is kept
+                // busy sending it, and one writing back always is
+                if (response.write_back || (!supplied && !requester_holds))
+                    keepSnooperBusy(cache, 2 * (cache.block_size / 4) - 1);
+                if (response.write_back)
                 {
-                    // comes from read miss
-                    // Read: Supply data if MODIFIED, update states
-                    if (line.state == MODIFIED)
-                    {
-                        // data gets copied to target cache
-                        // cache.idle_cycles += 2 * (cache.block_size / 4);      // Send block
-                        cache.stall_cycles += 2 * (cache.block_size / 4) - 1; // cache is kept busy in sending data
-                        bus_busy_cycles += 100;
-                        cache.stall_cycles += 100;
-                        global_stats.bus_data_traffic += cache.block_size;
-                        caches[initiator_core].data_traffic += cache.block_size; // Track data traffic for initiator core
-                        line.state = SHARED;
-                        supplied = true;
-                        shared = true;
-                    }
-                    else
-                    {
-                        // data gets copied to target cache
-                        if (!shared)
-                        {
-                            // cache.idle_cycles += 2 * (cache.block_size / 4);      // Send block
-                            cache.stall_cycles += 2 * (cache.block_size / 4) - 1; // cache is kept busy in sending data
-                        }
-                        global_stats.bus_data_traffic += cache.block_size;
-                        caches[initiator_core].data_traffic += cache.block_size; // Track data traffic for initiator core
-                        line.state = SHARED;
-                        supplied = true;
-                        shared = true;
-                    }
+                    uint32_t latency = writeBackOnBus(sim, addr);
+                    sim.bus_busy_cycles += latency;
+                    keepSnooperBusy(cache, latency);
                 }
+                sim.global_stats.bus_data_traffic += cache.block_size;
+                sim.caches[initiator_core].data_traffic += cache.block_size; // Track data traffic for initiator core
+                supplied = true;
             }
+            state = response.next;
+            shared = true;
         }
     }
 
     // If this transaction caused any invalidations, increment the initiator's count
     if (caused_invalidation && is_write)
     {
-        caches[initiator_core].invalidation_count++;
+        sim.caches[initiator_core].invalidation_count++;
     }
 }
 
 // Handle cache miss
-void handleMiss(int core, uint32_t addr, bool is_write, uint32_t set_index, uint32_t tag)
+template <class Policy, class Geometry>
+uint32_t handleMiss(Simulator &sim, int core, uint32_t addr, bool is_write, uint32_t set_index, uint32_t tag, bool prefetch)
 {
-    Cache &cache = caches[core];
-    auto &set = cache.sets[set_index];
-    int victim_index = findLRU(set);
-    bool writeback_pending = false;
+    PROFILE_SCOPE(PHASE_MISS);
+    PROFILE_COUNT(COUNT_MISS_FILLS);
+    Cache &cache = sim.caches[core];
+    uint32_t victim_index = findVictim<Policy, Geometry>(cache, set_index);
+    uint32_t victim = Geometry::line(cache, set_index, victim_index);
 
     // Evict if necessary
-    if (set[victim_index].state != INVALID)
+    if (cache.states[victim] != INVALID)
     {
         cache.eviction_count++;
-        if (set[victim_index].state == MODIFIED)
+        uint32_t victim_block = (cache.tags[victim] << cache.set_index_bits) | set_index;
+        sim.snoop_filter.remove(victim_block, core);
+        if (cache.prefetched[victim])
+            sim.prefetchers[core].unused++;
+        if (prefetch)
+            prefetchEvicted(sim, core, victim_block);
+        if (isDirty(cache.states[victim]))
         {
             // Write back to memory
-            cache.stall_cycles += 100-1;
-            bus_busy_cycles += 100;
-            // bus_queue.push({core, addr, is_write, true});
+            uint32_t writeback = writeBackOnBus(sim, victim_block << Geometry::blockOffsetBits(cache));
+            cache.stall_cycles += writeback - 1;
+            sim.bus_busy_cycles += writeback;
             cache.writeback_count++;
-            global_stats.bus_data_traffic += cache.block_size;
+            cache.dirty_eviction_count++;
+            sim.global_stats.bus_data_traffic += cache.block_size;
             cache.data_traffic += cache.block_size;
-            writeback_pending = true;
         }
+        else
+        {
+            dropCleanBlock(sim, victim_block << Geometry::blockOffsetBits(cache));
+        }
+        // Gone before the fill, so a back-invalidation cannot count it twice
+        cache.states[victim] = INVALID;
     }
 
     // Snoop other caches
     bool shared = false;
     bool supplied = false;
-    snoopBus(core, addr, is_write, shared, supplied);
+    snoopBus<Geometry>(sim, core, addr, is_write, shared, supplied);
 
-    // Only proceed with miss handling if no writeback is pending
-    if (true)
-    {
-        // writeback_pending = true;
-        // Fetch block
+    uint32_t latency = 0;
+    // Fetch block
+    if (!prefetch)
         cache.miss_count++;
-        set[victim_index].tag = tag;
-        if (supplied)
-        {
-            // Data supplied by another cache
-            cache.memory_cycles += 2 * (cache.block_size / 4);
-        }
-        else
-        {
-            // Fetch from memory
-            global_stats.bus_data_traffic += cache.block_size;
-            cache.data_traffic += cache.block_size;
-            cache.memory_cycles += 100;
-        }
-        set[victim_index].state = is_write ? MODIFIED : (supplied ? SHARED : EXCLUSIVE);
-        updateLRU(set, victim_index);
+    cache.tags[victim] = tag;
+    if (supplied)
+    {
+        // Data supplied by another cache
+        latency = 2 * (cache.block_size / 4);
+    }
+    else
+    {
+        // Fetch from the shared levels or memory
+        sim.global_stats.bus_data_traffic += cache.block_size;
+        cache.data_traffic += cache.block_size;
+        latency = readBlock(sim, addr);
     }
-}
\ No newline at end of file
+    if (!prefetch)
+        cache.memory_cycles += latency;
+    if (sim.sharing && !prefetch)
+        recordSharingAccess(*sim.sharing, core, addr, is_write, true, supplied);
+    cache.prefetched[victim] = prefetch;
+    cache.states[victim] = sim.protocol->fill(is_write, shared, supplied);
+    sim.snoop_filter.add(addr >> Geometry::blockOffsetBits(cache), core);
+    Policy::fill(cache, set_index, victim_index);
+    PROFILE_INCREMENT(cache.profile_replacement_updates);
+    return latency;
+}
+
+#define INSTANTIATE_SNOOP_BUS(Unused, Geometry) template void snoopBus<Geometry>(Simulator &, int, uint32_t, bool, bool &, bool &);
+FOR_EACH_GEOMETRY(INSTANTIATE_SNOOP_BUS, )
+
+#define INSTANTIATE_HANDLE_MISS_FOR(Policy, Geometry) template uint32_t handleMiss<Policy, Geometry>(Simulator &, int, uint32_t, bool, uint32_t, uint32_t, bool);
+#define INSTANTIATE_HANDLE_MISS(Policy) FOR_EACH_GEOMETRY(INSTANTIATE_HANDLE_MISS_FOR, Policy)
+FOR_EACH_REPLACEMENT_POLICY(INSTANTIATE_HANDLE_MISS)
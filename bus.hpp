@@ -3,24 +3,100 @@
 
 #include <vector>
 #include <queue>
+#include <unordered_map>
 #include "cache.hpp"
 
+struct Simulator;
+
 struct BusRequest {
     int core;
     uint32_t addr;
     bool is_write;
     bool iswriteback;
-    
+    uint64_t posted; // cycle the core started waiting for the bus
+};
+
+// The blocking bus holds the bus for a whole transaction, memory latency
+// included. The split-transaction bus (--bus split) separates the address
+// phase from the data phase: a memory fill holds the bus for one address
+// cycle, and up to max_outstanding fills wait on memory at once. Cores queue
+// requests while the bus is busy and the arbiter picks the next one.
+enum BusMode { BUS_BLOCKING, BUS_SPLIT };
+enum BusArbitration { ARBITRATION_FIFO, ARBITRATION_ROUND_ROBIN, ARBITRATION_PRIORITY };
+
+struct BusConfig {
+    BusMode mode = BUS_BLOCKING;
+    uint32_t max_outstanding = 4; // split bus: memory fills in flight at once
+    BusArbitration arbitration = ARBITRATION_FIFO;
+};
+
+// Parse --bus and --arbitration arguments; false if the name is unknown
+bool parseBusMode(const char *name, BusMode &mode);
+bool parseBusArbitration(const char *name, BusArbitration &arbitration);
+const char *busArbitrationName(BusArbitration arbitration);
+
+// Pending bus requests, at most one per core (cores block until granted),
+// except with non-blocking L1s, which queue one per MSHR
+struct BusArbiter {
+    BusArbitration policy = ARBITRATION_FIFO;
+    std::vector<BusRequest> pending; // in arrival order
+    int last_granted = -1;
+
+    bool empty() const { return pending.empty(); }
+    size_t size() const { return pending.size(); }
+    void push(const BusRequest &req) { pending.push_back(req); }
+    bool queued(int core) const
+    {
+        for (const BusRequest &req : pending)
+        {
+            if (req.core == core)
+                return true;
+        }
+        return false;
+    }
+    // Remove and return the request the policy grants next:
+    //   fifo         oldest request, lower core first within a cycle
+    //   round-robin  first requesting core after the last one granted
+    //   priority     lowest-numbered requesting core
+    BusRequest grant();
 };
 
-extern std::vector<Cache> caches;
-extern Stats global_stats;
-extern std::queue<BusRequest> bus_queue; 
-extern int bus_busy_cycles;
-extern int current_initiator;
-extern int bus_transactions;  // Global counter for bus transactions
+// Granted requests by cycles waited: bucket 0 is no wait, bucket k holds
+// waits of 2^(k-1) to 2^k - 1 cycles
+static const int BUS_WAIT_BUCKETS = 24;
+
+// Inclusive snoop filter: for every block held by any L1, a bitmap of the
+// cores holding a valid copy, so snoops only visit actual sharers
+static const int MAX_CORES = 64;
+
+struct SnoopFilter {
+    std::unordered_map<uint32_t, uint64_t> sharers; // block address -> core bitmap
+    uint64_t lookups = 0; // bus snoops that consulted the filter
+    uint64_t probes = 0;  // caches actually probed by those snoops
+
+    void add(uint32_t block, int core) { sharers[block] |= 1ULL << core; }
+    void remove(uint32_t block, int core)
+    {
+        auto it = sharers.find(block);
+        if (it == sharers.end())
+            return;
+        it->second &= ~(1ULL << core);
+        if (it->second == 0)
+            sharers.erase(it);
+    }
+    uint64_t lookup(uint32_t block) const
+    {
+        auto it = sharers.find(block);
+        return it == sharers.end() ? 0 : it->second;
+    }
+};
 
-void snoopBus(int initiator_core, uint32_t addr, bool is_write, bool& shared, bool& supplied);
-void handleMiss(int core, uint32_t addr, bool is_write, uint32_t set_index, uint32_t tag);
+template <class Geometry>
+void snoopBus(Simulator& sim, int initiator_core, uint32_t addr, bool is_write, bool& shared, bool& supplied);
+// Fill the line and return the cycles the data takes to arrive. A prefetch
+// fill is not counted as a miss and marks the line as prefetched.
+template <class Policy, class Geometry>
+uint32_t handleMiss(Simulator& sim, int core, uint32_t addr, bool is_write, uint32_t set_index, uint32_t tag,
+                    bool prefetch = false);
 
 #endif
\ No newline at end of file
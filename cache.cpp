@@ -1,7 +1,9 @@
 #include "cache.hpp"
-#include "bus.hpp"
+#include "simulator.hpp"
+#include "replacement.hpp"
 #include <iostream>
 #include <sstream>
+#include <cassert>
 
 void parseAddress(uint32_t addr, uint32_t set_index_bits, uint32_t block_offset_bits,
                   uint32_t &tag, uint32_t &set_index, uint32_t &block_offset)
@@ -13,79 +15,79 @@ void parseAddress(uint32_t addr, uint32_t set_index_bits, uint32_t block_offset_
     tag = addr;
 }
 
-int findLRU(const std::vector<CacheLine> &set)
+void initCache(Cache &cache, uint32_t set_index_bits, uint32_t assoc, uint32_t block_offset_bits,
+               ReplacementPolicy replacement, uint64_t seed)
 {
-    for (size_t i = 0; i < set.size(); ++i)
-    {
-        if (set[i].state == INVALID)
-        {
-            return i;
-        }
-    }
-    uint32_t max_lru = 0;
-    int lru_index = 0;
-    for (size_t i = 0; i < set.size(); ++i)
-    {
-        if (set[i].lru_counter > max_lru)
-        {
-            max_lru = set[i].lru_counter;
-            lru_index = i;
-        }
-    }
-    return lru_index;
+    cache.num_sets = 1 << set_index_bits;
+    cache.assoc = assoc;
+    cache.block_size = 1 << block_offset_bits;
+    cache.set_index_bits = set_index_bits;
+    cache.block_offset_bits = block_offset_bits;
+    cache.tag_bits = 32 - set_index_bits - block_offset_bits;
+    cache.replacement = replacement;
+    size_t lines = (size_t)cache.num_sets * assoc;
+    cache.tags.assign(lines, 0);
+    cache.states.assign(lines, INVALID);
+    cache.prefetched.assign(lines, 0);
+    cache.bus_wait_histogram.assign(BUS_WAIT_BUCKETS, 0);
+    initReplacement(cache, seed);
 }
 
-void updateLRU(std::vector<CacheLine> &set, int used_index)
+template <class Policy, class Geometry>
+void processReference(Simulator &sim, int core, char op, uint32_t addr)
 {
-    for (size_t i = 0; i < set.size(); ++i)
-    {
-        set[i].lru_counter++;
-    }
-    set[used_index].lru_counter = 0;
-}
-
-void processReference(int core, char op, uint32_t addr)
-{
-    Cache &cache = caches[core];
+    Cache &cache = sim.caches[core];
     bool is_write = (op == 'W');
     is_write ? cache.write_count++ : cache.read_count++;
 
     uint32_t tag, set_index, block_offset;
-    parseAddress(addr, cache.set_index_bits, cache.block_offset_bits, tag, set_index, block_offset);
-    auto &set = cache.sets[set_index];
+    Geometry::split(cache, addr, tag, set_index, block_offset);
 
-    bool hit = false;
-    int hit_index = -1;
-    for (size_t i = 0; i < set.size(); ++i)
-    {
-        if (set[i].state != INVALID && set[i].tag == tag)
-        {
-            hit = true;
-            hit_index = i;
-            break;
-        }
-    }
+    int hit_index = Geometry::findLine(cache, set_index, tag);
+    bool hit = hit_index >= 0;
+
+    // Requests queue from the first cycle the core wanted the bus
+    if (!cache.bus_waiting)
+        cache.bus_wait_start = sim.current_cycle;
+    cache.bus_waiting = false;
+    // A non-blocking cache keeps issuing; its MSHR tracks the request
+    int wait = sim.config.mshrs ? 0 : -1;
+#ifdef L1SIM_PROFILE
+    // A blocking core issues again only after its last request was granted;
+    // checked only in the instrumented build, as it scans the bus queue
+    assert(sim.config.mshrs || !sim.bus_queue.queued(core));
+#endif
 
     if (hit)
     {
+        // An upgrade hides any remaining prefetch latency, so only the use is counted
+        if (cache.prefetched[Geometry::line(cache, set_index, hit_index)])
+            prefetchOnUse(sim, core, Geometry::line(cache, set_index, hit_index), addr);
         // No idle cycles for cache hits - they take just 1 cycle
         if (is_write)
-        { // bus gets request only for misses or write hits at S
-            if (set[hit_index].state == SHARED)
+        { // bus gets request only for misses or write hits at shared copies
+            if (!isWritable(cache.state(set_index, hit_index)))
             {
-                bus_queue.push({core, addr, true, false}); // to invalidate all others
-                cache.stall_cycles = -1;
+                sim.bus_queue.push({core, addr, true, false, cache.bus_wait_start}); // to invalidate all others
+                cache.stall_cycles = wait;
             }
             else
             {
-                set[hit_index].state = MODIFIED;
+                cache.setState(set_index, hit_index, MODIFIED);
             }
         }
-        updateLRU(set, hit_index);
+        Policy::touch(cache, set_index, hit_index);
+        PROFILE_INCREMENT(cache.profile_replacement_updates);
     }
     else
     {
-        bus_queue.push({core, addr, is_write, false});
-        cache.stall_cycles = -1;
+        sim.bus_queue.push({core, addr, is_write, false, cache.bus_wait_start});
+        cache.stall_cycles = wait;
+        if (sim.config.prefetch.kind != PREFETCH_NONE)
+            prefetchOnMiss(sim, core, addr);
     }
-}
\ No newline at end of file
+}
+
+#define INSTANTIATE_PROCESS_REFERENCE_FOR(Policy, Geometry) template void processReference<Policy, Geometry>(Simulator &, int, char, uint32_t);
+#define INSTANTIATE_PROCESS_REFERENCE(Policy) FOR_EACH_GEOMETRY(INSTANTIATE_PROCESS_REFERENCE_FOR, Policy)
+FOR_EACH_REPLACEMENT_POLICY(INSTANTIATE_PROCESS_REFERENCE)
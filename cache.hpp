@@ -3,18 +3,55 @@
 
 #include <vector>
 #include <cstdint>
+#include "probe.hpp"
+#include "profile.hpp"
 
-enum MESIState { INVALID, SHARED, EXCLUSIVE, MODIFIED };
+// Line states of every coherence protocol (coherence.hpp). MESI uses the
+// first four; MOESI adds OWNED, a dirty copy other caches may share, and
+// MESIF adds FORWARD, the one clean shared copy that answers reads.
+// INVALID must stay 0: probeSet() treats any non-zero state as valid
+enum MESIState { INVALID, SHARED, EXCLUSIVE, MODIFIED, OWNED, FORWARD };
+static const int LINE_STATES = 6;
 
-struct CacheLine {
-    MESIState state;
-    uint32_t tag;
-    uint32_t lru_counter;
-    CacheLine() : state(INVALID), tag(0), lru_counter(0) {}
+// Holds data memory does not have, so it is written back when it goes
+inline bool isDirty(uint8_t state) { return state == MODIFIED || state == OWNED; }
+// The only copy, so a write hit needs no bus transaction
+inline bool isWritable(uint8_t state) { return state == EXCLUSIVE || state == MODIFIED; }
+
+// Replacement policy, selected with -r (see replacement.hpp).
+// REPL_LRU and REPL_LRU_COUNTER evict the same lines; the first keeps a
+// per-set recency list, the second ages a counter on every way.
+enum ReplacementPolicy { REPL_LRU, REPL_LRU_COUNTER, REPL_FIFO, REPL_PLRU, REPL_SRRIP, REPL_BRRIP, REPL_RANDOM };
+
+// Miss status holding register of a non-blocking cache: one outstanding
+// fill (or upgrade) and the later references merged into it
+struct MSHR {
+    uint32_t block;
+    bool is_write;        // the fill brings the block in MODIFIED
+    bool granted = false; // the bus has serviced the request
+    uint64_t ready = 0;   // cycle the data arrives, once granted
+    uint32_t merged = 0;  // later references to the block that waited on this fill
 };
 
+// The LRU/FIFO lists number ways in 16 bits, which bounds -E and --l2/--l3 ways
+static const uint32_t MAX_ASSOC = 65535;
+
+// Lines are stored as dense structure-of-arrays, indexed by set * assoc + way,
+// so probing a set touches one short run of tags and one of states
 struct Cache {
-    std::vector<std::vector<CacheLine>> sets;
+    std::vector<uint32_t> tags;
+    std::vector<uint8_t> states;       // MESIState per line
+    std::vector<uint8_t> prefetched;   // filled by a prefetch and not yet used (prefetch.hpp)
+    ReplacementPolicy replacement = REPL_LRU;
+    std::vector<uint32_t> lru_counters; // LRU counter: accesses since last use
+    std::vector<uint16_t> lru_prev;     // LRU/FIFO list: neighbour way towards the head
+    std::vector<uint16_t> lru_next;     // LRU/FIFO list: neighbour way towards the tail
+    std::vector<uint16_t> lru_head;     // LRU/FIFO list: most recent way per set
+    std::vector<uint16_t> lru_tail;     // LRU/FIFO list: next victim per set
+    std::vector<uint8_t> plru_bits;     // PLRU: tree node bits, plru_leaves per set
+    uint32_t plru_leaves = 0;           // PLRU: assoc rounded up to a power of two
+    std::vector<uint8_t> rrpv;          // RRIP: re-reference prediction per line
+    uint64_t rng_state = 0;             // Random/BRRIP generator state
     uint32_t num_sets;
     uint32_t assoc;
     uint32_t block_size;
@@ -25,6 +62,7 @@ struct Cache {
     uint64_t write_count = 0;
     uint64_t miss_count = 0;
     uint64_t eviction_count = 0;
+    uint64_t dirty_eviction_count = 0; // Evictions of dirty lines
     uint64_t writeback_count = 0;
     uint64_t idle_cycles = 0;
     uint64_t invalidation_count = 0; // Track invalidations per cache
@@ -32,25 +70,53 @@ struct Cache {
     uint64_t memory_cycles = 0;  // Cycles spent on memory accesses
     uint64_t data_traffic = 0;   // Data traffic in bytes for this core
     int stall_cycles = 0; // New field
+    bool bus_waiting = false;     // the current reference is waiting for the bus
+    uint64_t bus_wait_start = 0;  // cycle it started waiting
+    uint64_t bus_grants = 0;
+    uint64_t bus_wait_cycles = 0; // cycles between wanting the bus and being granted it
+    std::vector<uint64_t> bus_wait_histogram; // BUS_WAIT_BUCKETS entries (bus.hpp)
+    std::vector<MSHR> mshrs;             // non-blocking mode: outstanding misses
+    std::vector<uint64_t> mshr_occupancy; // cycles spent with n MSHRs in use
+    uint64_t mshr_merges = 0;            // references merged into an outstanding miss
+    uint64_t mshr_full_cycles = 0;       // cycles a miss waited for a free MSHR
+    uint64_t mshr_dependency_cycles = 0; // cycles a write waited for a pending read fill
+    // Instrumented builds only (profile.hpp): set probes and replacement state updates
+    mutable uint64_t profile_lookups = 0;
+    uint64_t profile_replacement_updates = 0;
+
+    uint32_t line(uint32_t set_index, uint32_t way) const { return set_index * assoc + way; }
+    MESIState state(uint32_t set_index, uint32_t way) const { return (MESIState)states[line(set_index, way)]; }
+    void setState(uint32_t set_index, uint32_t way, MESIState s) { states[line(set_index, way)] = s; }
+    uint32_t tag(uint32_t set_index, uint32_t way) const { return tags[line(set_index, way)]; }
+
+    // Way holding a valid copy of tag in the set, or -1 on a miss
+    int findLine(uint32_t set_index, uint32_t tag) const
+    {
+        PROFILE_INCREMENT(profile_lookups);
+        return probeSet(&tags[set_index * assoc], &states[set_index * assoc], assoc, tag);
+    }
 };
 
+// Size the cache for the given geometry and allocate its line arrays
+void initCache(Cache &cache, uint32_t set_index_bits, uint32_t assoc, uint32_t block_offset_bits,
+               ReplacementPolicy replacement = REPL_LRU, uint64_t seed = 1);
+
 struct Stats {
     uint64_t total_cycles = 0;
     uint64_t invalidations = 0;
     uint64_t bus_data_traffic = 0;
+    uint64_t bus_busy_cycles = 0; // cycles the snooping bus was held
+    uint64_t writeback_cycles = 0; // cycles L1s spent writing dirty blocks back on the bus
 };
 
 // Parse memory address
 void parseAddress(uint32_t addr, uint32_t set_index_bits, uint32_t block_offset_bits,
                  uint32_t& tag, uint32_t& set_index, uint32_t& block_offset);
 
-// Find LRU line in a set
-int findLRU(const std::vector<CacheLine>& set);
-
-// Update LRU counters
-void updateLRU(std::vector<CacheLine>& set, int used_index);
+struct Simulator;
 
 // Process memory reference
-void processReference(int core, char op, uint32_t addr);
+template <class Policy, class Geometry>
+void processReference(Simulator &sim, int core, char op, uint32_t addr);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "coherence.hpp"
+#include <cstring>
+#include <string>
+
+// Rows are indexed by MESIState: INVALID, SHARED, EXCLUSIVE, MODIFIED, OWNED, FORWARD.
+// States a protocol does not use never occur and keep the INVALID row.
+static const SnoopResponse NONE = {INVALID, false, false};
+static const SnoopResponse INVALIDATE = {INVALID, false, false};
+static const SnoopResponse WRITE_BACK_AND_INVALIDATE = {INVALID, false, true};
+
+static const ProtocolTable PROTOCOLS[] = {
+    // MESI
+    {
+        {NONE, {SHARED, true, false}, {SHARED, true, false}, {SHARED, true, true}, NONE, NONE},
+        {NONE, INVALIDATE, INVALIDATE, WRITE_BACK_AND_INVALIDATE, NONE, NONE},
+        {NONE, INVALIDATE, NONE, NONE, NONE, NONE},
+        MODIFIED, SHARED, SHARED, EXCLUSIVE,
+    },
+    // MOESI
+    {
+        {NONE, {SHARED, true, false}, {SHARED, true, false}, {OWNED, true, false}, {OWNED, true, false}, NONE},
+        {NONE, INVALIDATE, INVALIDATE, WRITE_BACK_AND_INVALIDATE, WRITE_BACK_AND_INVALIDATE, NONE},
+        {NONE, INVALIDATE, NONE, NONE, INVALIDATE, NONE},
+        MODIFIED, SHARED, SHARED, EXCLUSIVE,
+    },
+    // MESIF
+    {
+        {NONE, {SHARED, false, false}, {FORWARD, true, false}, {FORWARD, true, true}, NONE, {FORWARD, true, false}},
+        {NONE, INVALIDATE, INVALIDATE, WRITE_BACK_AND_INVALIDATE, NONE, INVALIDATE},
+        {NONE, INVALIDATE, NONE, NONE, NONE, INVALIDATE},
+        MODIFIED, SHARED, FORWARD, EXCLUSIVE,
+    },
+};
+
+const ProtocolTable &protocolTable(CoherenceProtocol protocol)
+{
+    return PROTOCOLS[protocol];
+}
+
+bool parseCoherenceProtocol(const char *name, CoherenceProtocol &protocol)
+{
+    if (strcmp(name, "mesi") == 0)
+        protocol = PROTOCOL_MESI;
+    else if (strcmp(name, "moesi") == 0)
+        protocol = PROTOCOL_MOESI;
+    else if (strcmp(name, "mesif") == 0)
+        protocol = PROTOCOL_MESIF;
+    else
+        return false;
+    return true;
+}
+
+bool parseCoherenceProtocols(const char *arg, std::vector<CoherenceProtocol> &protocols)
+{
+    protocols.clear();
+    if (strcmp(arg, "all") == 0)
+    {
+        protocols = {PROTOCOL_MESI, PROTOCOL_MOESI, PROTOCOL_MESIF};
+        return true;
+    }
+    std::string list = arg;
+    size_t start = 0;
+    while (true)
+    {
+        size_t comma = list.find(',', start);
+        CoherenceProtocol protocol;
+        if (!parseCoherenceProtocol(list.substr(start, comma - start).c_str(), protocol))
+            return false;
+        protocols.push_back(protocol);
+        if (comma == std::string::npos)
+            return true;
+        start = comma + 1;
+    }
+}
+
+const char *coherenceProtocolName(CoherenceProtocol protocol)
+{
+    switch (protocol)
+    {
+    case PROTOCOL_MESI:
+        return "MESI";
+    case PROTOCOL_MOESI:
+        return "MOESI";
+    case PROTOCOL_MESIF:
+        return "MESIF";
+    }
+    return "unknown";
+}
@@ -0,0 +1,62 @@
+#ifndef COHERENCE_HPP
+#define COHERENCE_HPP
+
+#include <vector>
+#include <cstdint>
+#include "cache.hpp"
+
+// Snooping coherence protocols (--protocol). The bus logic is the same for
+// all of them; a protocol is a table of what a cache holding the block does
+// when it snoops another core's request, and of the state the requester
+// fills the block in.
+//   MESI   every copy answers a read; a MODIFIED copy is written back to
+//          memory first and becomes SHARED
+//   MOESI  a MODIFIED copy answers a read without the writeback and becomes
+//          OWNED: it stays dirty, keeps answering reads and is written back
+//          only when it is evicted or invalidated
+//   MESIF  only the FORWARD, EXCLUSIVE or MODIFIED copy answers a read, and
+//          becomes (or stays) FORWARD; SHARED copies stay silent. A reader
+//          that no cache answers while copies exist takes over FORWARD.
+// A write miss invalidates every other copy under all three, writing back
+// dirty ones, and is filled from below, not by another cache. A write hit to
+// a shared, owned or forward copy upgrades it: the bus transaction
+// invalidates the other copies and the writer's becomes MODIFIED. The
+// upgrading core has the current data, so an owned copy it invalidates is
+// not written back.
+
+enum CoherenceProtocol { PROTOCOL_MESI, PROTOCOL_MOESI, PROTOCOL_MESIF };
+
+// What a cache holding the block in some state does on a snooped request
+struct SnoopResponse {
+    uint8_t next;    // state afterwards
+    bool supply;     // sends the block to the requester
+    bool write_back; // writes the block back below the L1s first
+};
+
+struct ProtocolTable {
+    SnoopResponse read[LINE_STATES];    // another core's read miss
+    SnoopResponse write[LINE_STATES];   // another core's write miss
+    SnoopResponse upgrade[LINE_STATES]; // another core's write hit to a copy it shares
+    // The requester's state after a write miss, and after a read miss that
+    // another cache supplied, that only memory supplied while other caches
+    // hold the block, or that no other cache holds
+    uint8_t fill_write;
+    uint8_t fill_supplied;
+    uint8_t fill_shared;
+    uint8_t fill_exclusive;
+
+    uint8_t fill(bool is_write, bool shared, bool supplied) const
+    {
+        return is_write ? fill_write : supplied ? fill_supplied : shared ? fill_shared : fill_exclusive;
+    }
+};
+
+const ProtocolTable &protocolTable(CoherenceProtocol protocol);
+
+// Parse a --protocol name, or a comma-separated list of them ("all" names
+// every protocol); false if a name is unknown
+bool parseCoherenceProtocol(const char *name, CoherenceProtocol &protocol);
+bool parseCoherenceProtocols(const char *arg, std::vector<CoherenceProtocol> &protocols);
+const char *coherenceProtocolName(CoherenceProtocol protocol);
+
+#endif
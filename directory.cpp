@@ -0,0 +1,234 @@
+#include "simulator.hpp"
+#include "replacement.hpp"
+#include <queue>
+#include <algorithm>
+
+// Tell the home directory a line left the cache; a dirty line is written back
+// to the shared levels or memory first. Returns the latency this adds to the miss.
+static uint32_t evictLine(Simulator &sim, int core, uint32_t set_index, uint32_t line)
+{
+    Cache &cache = sim.caches[core];
+    if (cache.states[line] == INVALID)
+        return 0;
+
+    cache.eviction_count++;
+    uint32_t block = (cache.tags[line] << cache.set_index_bits) | set_index;
+    DirectoryEntry &entry = sim.directory[block];
+    entry.sharers &= ~(1ULL << core);
+    if (entry.sharers == 0)
+        entry.owned = false;
+    sim.directory_stats.lookups++;
+    sim.directory_stats.messages++;
+
+    // Gone before the fill, so a back-invalidation cannot count it twice
+    bool dirty = cache.states[line] == MODIFIED;
+    cache.states[line] = INVALID;
+    if (!dirty)
+    {
+        dropCleanBlock(sim, block << cache.block_offset_bits);
+        return 0;
+    }
+    cache.writeback_count++;
+    cache.dirty_eviction_count++;
+    sim.global_stats.bus_data_traffic += cache.block_size;
+    cache.data_traffic += cache.block_size;
+    return sim.config.directory_config.hop_latency + writeBackBlock(sim, block << cache.block_offset_bits);
+}
+
+// One coherence transaction at the block's home directory: a read or write
+// miss, or an upgrade of a SHARED line (way >= 0). Applies all state changes
+// and returns the latency seen by the requesting core.
+template <class Policy>
+static uint32_t directoryTransaction(Simulator &sim, int core, uint32_t addr, bool is_write, uint32_t set_index, uint32_t tag,
+                                     int way, DirectoryEntry &entry)
+{
+    const DirectoryConfig &cfg = sim.config.directory_config;
+    Cache &cache = sim.caches[core];
+    uint32_t transfer = 2 * (cache.block_size / 4);
+    bool miss = way < 0;
+    uint32_t latency = 0;
+
+    if (miss)
+    {
+        way = findVictim<Policy>(cache, set_index);
+        latency += evictLine(sim, core, set_index, cache.line(set_index, way));
+    }
+
+    // Request message to the home node and directory access
+    sim.directory_stats.transactions++;
+    sim.directory_stats.lookups++;
+    sim.directory_stats.messages++;
+    sim.bus_transactions++;
+    latency += cfg.hop_latency + cfg.lookup_latency;
+
+    uint64_t others = entry.sharers & ~(1ULL << core);
+    uint32_t data_path = cfg.hop_latency; // grant with no data
+    MESIState new_state;
+
+    if (!is_write)
+    {
+        if (entry.owned && others)
+        {
+            // Forward to the owner, which sends the block straight to us
+            int owner = __builtin_ctzll(others);
+            Cache &owner_cache = sim.caches[owner];
+            int owner_way = owner_cache.findLine(set_index, tag);
+            if (owner_way >= 0)
+            {
+                if (owner_cache.state(set_index, owner_way) == MODIFIED)
+                {
+                    // The owner also updates memory as it downgrades, off the requester's path
+                    writeBackBlock(sim, addr);
+                    owner_cache.writeback_count++;
+                    sim.global_stats.bus_data_traffic += cache.block_size;
+                    sim.directory_stats.messages++;
+                }
+                owner_cache.setState(set_index, owner_way, SHARED);
+            }
+            sim.directory_stats.forwarded++;
+            sim.directory_stats.messages += 2;
+            data_path = cfg.hop_latency + transfer + cfg.hop_latency;
+            new_state = SHARED;
+        }
+        else
+        {
+            sim.directory_stats.messages++;
+            data_path = readBlock(sim, addr) + cfg.hop_latency;
+            new_state = others ? SHARED : EXCLUSIVE;
+        }
+        sim.global_stats.bus_data_traffic += cache.block_size;
+        cache.data_traffic += cache.block_size;
+        entry.sharers |= 1ULL << core;
+        entry.owned = new_state == EXCLUSIVE;
+        latency += data_path;
+    }
+    else
+    {
+        if (entry.owned && others)
+        {
+            // The owner hands over the block and invalidates its copy
+            sim.directory_stats.forwarded++;
+            sim.directory_stats.messages += 2;
+            data_path = cfg.hop_latency + transfer + cfg.hop_latency;
+            sim.global_stats.bus_data_traffic += cache.block_size;
+            cache.data_traffic += cache.block_size;
+        }
+        else if (miss)
+        {
+            sim.directory_stats.messages++;
+            data_path = readBlock(sim, addr) + cfg.hop_latency;
+            sim.global_stats.bus_data_traffic += cache.block_size;
+            cache.data_traffic += cache.block_size;
+        }
+
+        // Invalidations go out in parallel; the requester collects the acks
+        uint32_t fanout = 0;
+        uint64_t victims = others;
+        while (victims)
+        {
+            int i = __builtin_ctzll(victims);
+            victims &= victims - 1;
+            int i_way = sim.caches[i].findLine(set_index, tag);
+            if (i_way >= 0)
+                sim.caches[i].setState(set_index, i_way, INVALID);
+            fanout++;
+            sim.global_stats.invalidations++;
+        }
+        if (fanout)
+        {
+            cache.invalidation_count++;
+            sim.directory_stats.invalidations_sent += fanout;
+            sim.directory_stats.messages += 2 * fanout;
+        }
+        sim.directory_stats.fanout[fanout]++;
+        entry.sharers = 1ULL << core;
+        entry.owned = true;
+        new_state = MODIFIED;
+        latency += std::max(data_path, fanout ? 2 * cfg.hop_latency : 0);
+    }
+
+    if (miss)
+    {
+        cache.miss_count++;
+        cache.tags[cache.line(set_index, way)] = tag;
+        Policy::fill(cache, set_index, way);
+        PROFILE_INCREMENT(cache.profile_replacement_updates);
+    }
+    cache.setState(set_index, way, new_state);
+    return latency;
+}
+
+template <class Policy>
+void simulateDirectory(Simulator &sim)
+{
+    sim.directory_stats.fanout.assign(sim.num_cores + 1, 0);
+
+    // Cores are stepped in order of the cycle they can issue their next
+    // reference, lowest core first on ties
+    typedef std::pair<uint64_t, int> Event;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> ready;
+    for (int core = 0; core < sim.num_cores; ++core)
+    {
+        if (!sim.traces[core].done())
+            ready.push(Event(0, core));
+    }
+
+    uint64_t finish = 0;
+    while (!ready.empty())
+    {
+        PROFILE_TICK(sim);
+        uint64_t now = ready.top().first;
+        int core = ready.top().second;
+        ready.pop();
+
+        Cache &cache = sim.caches[core];
+        char op = sim.traces[core].current().op;
+        uint32_t addr = sim.traces[core].current().addr;
+        bool is_write = (op == 'W');
+        is_write ? cache.write_count++ : cache.read_count++;
+
+        uint32_t tag, set_index, block_offset;
+        parseAddress(addr, cache.set_index_bits, cache.block_offset_bits, tag, set_index, block_offset);
+        int way = cache.findLine(set_index, tag);
+
+        uint64_t done;
+        if (way >= 0 && !(is_write && cache.state(set_index, way) == SHARED))
+        {
+            // Hits, including silent E -> M upgrades, never leave the core
+            if (is_write)
+                cache.setState(set_index, way, MODIFIED);
+            Policy::touch(cache, set_index, way);
+            PROFILE_INCREMENT(cache.profile_replacement_updates);
+            cache.hit_cycles++;
+            done = now + 1;
+        }
+        else
+        {
+            if (way >= 0)
+            {
+                Policy::touch(cache, set_index, way);
+                PROFILE_INCREMENT(cache.profile_replacement_updates);
+            }
+            DirectoryEntry &entry = sim.directory[addr >> cache.block_offset_bits];
+            uint64_t start = std::max(now, entry.busy_until);
+            cache.idle_cycles += start - now;
+            sim.directory_stats.queued_cycles += start - now;
+
+            uint32_t latency = directoryTransaction<Policy>(sim, core, addr, is_write, set_index, tag, way, entry);
+            cache.memory_cycles += latency;
+            done = start + latency;
+            entry.busy_until = done;
+        }
+
+        sim.traces[core].advance();
+        if (!sim.traces[core].done())
+            ready.push(Event(done, core));
+        finish = std::max(finish, done);
+    }
+
+    sim.current_cycle = finish;
+    sim.global_stats.total_cycles = finish;
+}
+
+#define INSTANTIATE_SIMULATE_DIRECTORY(Policy) template void simulateDirectory<Policy>(Simulator &);
+FOR_EACH_REPLACEMENT_POLICY(INSTANTIATE_SIMULATE_DIRECTORY)
@@ -0,0 +1,45 @@
+#ifndef DIRECTORY_HPP
+#define DIRECTORY_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "cache.hpp"
+
+// Directory-based MESI, an alternative to the snooping bus (--coherence directory).
+// Each block has a home directory entry with a sharer vector. Requests,
+// forwards, invalidations and acks are point-to-point messages, and
+// transactions to different blocks proceed concurrently; only transactions
+// to the same block are serialized at its directory entry.
+
+enum CoherenceMode { COHERENCE_SNOOP, COHERENCE_DIRECTORY };
+
+struct DirectoryConfig {
+    uint32_t hop_latency = 5;     // one point-to-point message
+    uint32_t lookup_latency = 10; // directory access at the home node
+    uint32_t memory_latency = 100;
+};
+
+struct DirectoryEntry {
+    uint64_t sharers = 0;    // cores holding a valid copy
+    bool owned = false;      // the single sharer holds the block in E or M
+    uint64_t busy_until = 0; // cycle the block's last transaction completes
+};
+
+struct DirectoryStats {
+    uint64_t transactions = 0;       // requests that reached a directory
+    uint64_t lookups = 0;            // directory entry accesses (incl. eviction notices)
+    uint64_t forwarded = 0;          // requests forwarded to an owning cache
+    uint64_t invalidations_sent = 0; // invalidation messages
+    uint64_t messages = 0;           // all point-to-point messages
+    uint64_t queued_cycles = 0;      // cycles requests waited on a busy block
+    std::vector<uint64_t> fanout;    // write transactions by number of caches invalidated
+};
+
+struct Simulator;
+
+// Run the trace through the directory protocol instead of simulate()
+template <class Policy>
+void simulateDirectory(Simulator &sim);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+
+#include <cstdint>
+#include "cache.hpp"
+
+// Cache geometry as seen by the snooping simulator. Like the replacement
+// policies, a geometry is a set of static hooks the simulator is
+// instantiated with:
+//   matches(s, E, b)              whether this instance models the configuration
+//   split(cache, addr, ...)       tag, set index and block offset of an address
+//   ways(cache), line(...)        associativity and line index within the arrays
+//   findLine(cache, set, tag)     set probe
+//   blockSize(cache), blockOffsetBits(cache)
+// DynamicGeometry reads everything from the Cache at run time.
+// FixedGeometry<S, E, B> makes the masks and way count constants, so set
+// loops have a fixed trip count and the compiler can unroll them.
+
+struct DynamicGeometry {
+    static bool matches(int, int, int) { return true; }
+    static uint32_t ways(const Cache &cache) { return cache.assoc; }
+    static uint32_t blockSize(const Cache &cache) { return cache.block_size; }
+    static uint32_t blockOffsetBits(const Cache &cache) { return cache.block_offset_bits; }
+    static uint32_t line(const Cache &cache, uint32_t set_index, uint32_t way) { return cache.line(set_index, way); }
+    static void split(const Cache &cache, uint32_t addr, uint32_t &tag, uint32_t &set_index, uint32_t &block_offset)
+    {
+        parseAddress(addr, cache.set_index_bits, cache.block_offset_bits, tag, set_index, block_offset);
+    }
+    static int findLine(const Cache &cache, uint32_t set_index, uint32_t tag) { return cache.findLine(set_index, tag); }
+};
+
+template <uint32_t SetBits, uint32_t Ways, uint32_t BlockBits>
+struct FixedGeometry {
+    static bool matches(int set_index_bits, int assoc, int block_bits)
+    {
+        return set_index_bits == (int)SetBits && assoc == (int)Ways && block_bits == (int)BlockBits;
+    }
+    static uint32_t ways(const Cache &) { return Ways; }
+    static uint32_t blockSize(const Cache &) { return 1u << BlockBits; }
+    static uint32_t blockOffsetBits(const Cache &) { return BlockBits; }
+    static uint32_t line(const Cache &, uint32_t set_index, uint32_t way) { return set_index * Ways + way; }
+    static void split(const Cache &, uint32_t addr, uint32_t &tag, uint32_t &set_index, uint32_t &block_offset)
+    {
+        block_offset = addr & ((1u << BlockBits) - 1);
+        set_index = (addr >> BlockBits) & ((1u << SetBits) - 1);
+        tag = addr >> (BlockBits + SetBits);
+    }
+    static int findLine(const Cache &cache, uint32_t set_index, uint32_t tag)
+    {
+        PROFILE_INCREMENT(cache.profile_lookups);
+        return probeSet(&cache.tags[set_index * Ways], &cache.states[set_index * Ways], Ways, tag);
+    }
+};
+
+// Prebuilt specializations, for the geometries production sweeps use most
+typedef FixedGeometry<6, 2, 5> GeometryS6E2B5;
+typedef FixedGeometry<8, 8, 6> GeometryS8E8B6;
+
+// Expands MACRO(Arg, Geometry) once per geometry, for explicit
+// instantiations and dispatch. DynamicGeometry matches any configuration,
+// so it comes last.
+#define FOR_EACH_GEOMETRY(MACRO, Arg) \
+    MACRO(Arg, GeometryS6E2B5)        \
+    MACRO(Arg, GeometryS8E8B6)        \
+    MACRO(Arg, DynamicGeometry)
+
+#endif
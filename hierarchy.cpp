@@ -0,0 +1,259 @@
+#include "hierarchy.hpp"
+#include "simulator.hpp"
+#include "replacement.hpp"
+#include <cstdlib>
+#include <cstring>
+
+bool parseLevelConfig(const char *arg, LevelConfig &level)
+{
+    char *next;
+    unsigned long values[3];
+    const char *p = arg;
+    for (int i = 0; i < 3; ++i)
+    {
+        values[i] = strtoul(p, &next, 10);
+        if (next == p || (*next != ',' && (*next != '\0' || i < 2)))
+            return false;
+        p = *next ? next + 1 : next;
+    }
+    if (values[0] == 0 || values[1] == 0)
+        return false;
+    level.size_kb = values[0];
+    level.assoc = values[1];
+    level.latency = values[2];
+    level.inclusion = INCLUSION_INCLUSIVE;
+    if (*next == '\0')
+        return true;
+    if (strcmp(p, "inclusive") == 0)
+        level.inclusion = INCLUSION_INCLUSIVE;
+    else if (strcmp(p, "exclusive") == 0)
+        level.inclusion = INCLUSION_EXCLUSIVE;
+    else if (strcmp(p, "nine") == 0)
+        level.inclusion = INCLUSION_NINE;
+    else
+        return false;
+    return true;
+}
+
+const char *inclusionPolicyName(InclusionPolicy inclusion)
+{
+    switch (inclusion)
+    {
+    case INCLUSION_INCLUSIVE:
+        return "inclusive";
+    case INCLUSION_EXCLUSIVE:
+        return "exclusive";
+    case INCLUSION_NINE:
+        return "non-inclusive non-exclusive";
+    }
+    return "unknown";
+}
+
+uint32_t levelSets(const LevelConfig &level, uint32_t block_offset_bits)
+{
+    uint64_t sets = ((uint64_t)level.size_kb * 1024 >> block_offset_bits) / level.assoc;
+    if (sets == 0 || (sets & (sets - 1)) != 0 || sets > (1u << 30))
+        return 0;
+    return sets;
+}
+
+void initHierarchy(MemoryHierarchy &hierarchy, const std::vector<LevelConfig> &levels, uint32_t block_offset_bits,
+                   uint32_t memory_latency)
+{
+    hierarchy.block_offset_bits = block_offset_bits;
+    hierarchy.memory_latency = memory_latency;
+    hierarchy.levels.resize(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        // Sizes that do not split into a power-of-two number of sets are
+        // rejected by the front end; round down for library callers
+        uint32_t set_index_bits = 0;
+        uint64_t sets = ((uint64_t)levels[i].size_kb * 1024 >> block_offset_bits) / levels[i].assoc;
+        while ((2ULL << set_index_bits) <= sets)
+            set_index_bits++;
+        hierarchy.levels[i].config = levels[i];
+        initCache(hierarchy.levels[i].cache, set_index_bits, levels[i].assoc, block_offset_bits);
+    }
+}
+
+static uint32_t blockAddress(const Cache &cache, uint32_t set_index, uint32_t way)
+{
+    return ((cache.tag(set_index, way) << cache.set_index_bits) | set_index) << cache.block_offset_bits;
+}
+
+// Remove every copy of the block from the caches above `level`, as that
+// level evicts it. Returns true if one of them was dirty.
+static bool backInvalidate(Simulator &sim, size_t level, uint32_t addr)
+{
+    SharedLevel &evicting = sim.hierarchy.levels[level];
+    uint32_t tag, set_index, block_offset;
+    bool dirty = false;
+
+    for (size_t i = 0; i < level; ++i)
+    {
+        Cache &upper = sim.hierarchy.levels[i].cache;
+        parseAddress(addr, upper.set_index_bits, upper.block_offset_bits, tag, set_index, block_offset);
+        int way = upper.findLine(set_index, tag);
+        if (way < 0)
+            continue;
+        dirty |= upper.state(set_index, way) == MODIFIED;
+        upper.setState(set_index, way, INVALID);
+        evicting.back_invalidations++;
+    }
+
+    uint32_t block = addr >> sim.hierarchy.block_offset_bits;
+    for (int core = 0; core < sim.num_cores; ++core)
+    {
+        Cache &cache = sim.caches[core];
+        parseAddress(addr, cache.set_index_bits, cache.block_offset_bits, tag, set_index, block_offset);
+        int way = cache.findLine(set_index, tag);
+        if (way < 0)
+            continue;
+        if (isDirty(cache.state(set_index, way)))
+        {
+            cache.writeback_count++;
+            dirty = true;
+        }
+        cache.setState(set_index, way, INVALID);
+        sim.snoop_filter.remove(block, core);
+        auto entry = sim.directory.find(block);
+        if (entry != sim.directory.end())
+        {
+            entry->second.sharers &= ~(1ULL << core);
+            if (entry->second.sharers == 0)
+                entry->second.owned = false;
+        }
+        evicting.back_invalidations++;
+    }
+    return dirty;
+}
+
+static void insertLevel(Simulator &sim, size_t level, uint32_t addr, bool dirty);
+
+// Write a dirty block into `level` (or memory below the last level).
+// Returns the latency of the write; callers off the critical path ignore it.
+static uint32_t writeLevel(Simulator &sim, size_t level, uint32_t addr)
+{
+    MemoryHierarchy &h = sim.hierarchy;
+    if (level == h.levels.size())
+    {
+        h.memory_writes++;
+        return h.memory_latency;
+    }
+    h.levels[level].writes++;
+    insertLevel(sim, level, addr, true);
+    return h.levels[level].config.latency;
+}
+
+// Evict one line from `level`, moving it down: into the next level if that
+// one is exclusive, else to the next level or memory if it is dirty
+static void evictLevel(Simulator &sim, size_t level, uint32_t set_index, uint32_t way)
+{
+    MemoryHierarchy &h = sim.hierarchy;
+    SharedLevel &l = h.levels[level];
+    uint32_t addr = blockAddress(l.cache, set_index, way);
+    bool dirty = l.cache.state(set_index, way) == MODIFIED;
+    l.evictions++;
+    l.cache.setState(set_index, way, INVALID);
+    if (l.config.inclusion == INCLUSION_INCLUSIVE)
+        dirty |= backInvalidate(sim, level, addr);
+    if (dirty)
+        l.writebacks++;
+
+    if (level + 1 < h.levels.size() && h.levels[level + 1].config.inclusion == INCLUSION_EXCLUSIVE)
+        insertLevel(sim, level + 1, addr, dirty);
+    else if (dirty)
+        writeLevel(sim, level + 1, addr);
+}
+
+// Place the block in `level`, evicting an LRU victim if the set is full
+static void insertLevel(Simulator &sim, size_t level, uint32_t addr, bool dirty)
+{
+    Cache &cache = sim.hierarchy.levels[level].cache;
+    uint32_t tag, set_index, block_offset;
+    parseAddress(addr, cache.set_index_bits, cache.block_offset_bits, tag, set_index, block_offset);
+
+    int way = cache.findLine(set_index, tag);
+    if (way >= 0)
+    {
+        if (dirty)
+            cache.setState(set_index, way, MODIFIED);
+        LRUPolicy::touch(cache, set_index, way);
+        PROFILE_INCREMENT(cache.profile_replacement_updates);
+        return;
+    }
+    way = findVictim<LRUPolicy>(cache, set_index);
+    if (cache.state(set_index, way) != INVALID)
+        evictLevel(sim, level, set_index, way);
+    cache.tags[cache.line(set_index, way)] = tag;
+    cache.setState(set_index, way, dirty ? MODIFIED : EXCLUSIVE);
+    LRUPolicy::fill(cache, set_index, way);
+    PROFILE_INCREMENT(cache.profile_replacement_updates);
+}
+
+static uint32_t readLevel(Simulator &sim, size_t level, uint32_t addr)
+{
+    MemoryHierarchy &h = sim.hierarchy;
+    if (level == h.levels.size())
+    {
+        h.memory_reads++;
+        h.memory_cycles += h.memory_latency;
+        return h.memory_latency;
+    }
+
+    SharedLevel &l = h.levels[level];
+    l.reads++;
+    l.cycles += l.config.latency;
+    uint32_t tag, set_index, block_offset;
+    parseAddress(addr, l.cache.set_index_bits, l.cache.block_offset_bits, tag, set_index, block_offset);
+    int way = l.cache.findLine(set_index, tag);
+    if (way >= 0)
+    {
+        l.read_hits++;
+        if (l.config.inclusion == INCLUSION_EXCLUSIVE)
+        {
+            // The block moves up; dirty data goes further down, off the critical path
+            bool dirty = l.cache.state(set_index, way) == MODIFIED;
+            l.cache.setState(set_index, way, INVALID);
+            if (dirty)
+            {
+                l.writebacks++;
+                writeLevel(sim, level + 1, addr);
+            }
+        }
+        else
+        {
+            LRUPolicy::touch(l.cache, set_index, way);
+            PROFILE_INCREMENT(l.cache.profile_replacement_updates);
+        }
+        return l.config.latency;
+    }
+
+    uint32_t latency = l.config.latency + readLevel(sim, level + 1, addr);
+    if (l.config.inclusion != INCLUSION_EXCLUSIVE)
+        insertLevel(sim, level, addr, false);
+    return latency;
+}
+
+uint32_t readBlock(Simulator &sim, uint32_t addr)
+{
+    return readLevel(sim, 0, addr);
+}
+
+uint32_t writeBackBlock(Simulator &sim, uint32_t addr)
+{
+    MemoryHierarchy &h = sim.hierarchy;
+    uint32_t latency = writeLevel(sim, 0, addr);
+    if (h.levels.empty())
+        h.memory_cycles += latency;
+    else
+        h.levels[0].cycles += latency;
+    return latency;
+}
+
+void dropCleanBlock(Simulator &sim, uint32_t addr)
+{
+    MemoryHierarchy &h = sim.hierarchy;
+    if (!h.levels.empty() && h.levels[0].config.inclusion == INCLUSION_EXCLUSIVE)
+        insertLevel(sim, 0, addr, false);
+}
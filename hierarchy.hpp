@@ -0,0 +1,69 @@
+#ifndef HIERARCHY_HPP
+#define HIERARCHY_HPP
+
+#include <vector>
+#include <cstdint>
+#include "cache.hpp"
+
+// Optional shared caches between the private L1s and memory (--l2, --l3).
+// Every L1 fill that no other L1 supplies reads the block through these
+// levels, and every dirty L1 line is written back into the first of them.
+// With no levels configured a read or writeback costs the memory latency,
+// as before. Shared levels use the L1 block size and LRU replacement.
+//   inclusive  holds every block any cache above it holds; evicting a block
+//              back-invalidates the copies above
+//   exclusive  holds only blocks evicted from the level above; a hit moves
+//              the block up and out of this level
+//   nine       (non-inclusive, non-exclusive) is filled on misses like an
+//              inclusive level but evicts without back-invalidation
+
+enum InclusionPolicy { INCLUSION_INCLUSIVE, INCLUSION_EXCLUSIVE, INCLUSION_NINE };
+
+struct LevelConfig {
+    uint32_t size_kb = 0;
+    uint32_t assoc = 1;
+    uint32_t latency = 0;
+    InclusionPolicy inclusion = INCLUSION_INCLUSIVE;
+};
+
+struct SharedLevel {
+    LevelConfig config;
+    Cache cache;                      // states: INVALID, EXCLUSIVE (clean) or MODIFIED (dirty)
+    uint64_t reads = 0;               // fills requested from this level
+    uint64_t read_hits = 0;
+    uint64_t writes = 0;              // dirty blocks written into this level
+    uint64_t evictions = 0;
+    uint64_t writebacks = 0;          // dirty victims sent further down
+    uint64_t back_invalidations = 0;  // copies above removed by this level's evictions
+    uint64_t cycles = 0;              // latency this level added to L1 misses and writebacks
+};
+
+struct MemoryHierarchy {
+    std::vector<SharedLevel> levels;  // L2, then L3
+    uint32_t block_offset_bits = 0;
+    uint32_t memory_latency = 100;
+    uint64_t memory_reads = 0;
+    uint64_t memory_writes = 0;
+    uint64_t memory_cycles = 0;       // latency memory added to L1 misses and writebacks
+};
+
+// Parse a --l2/--l3 argument "<size KB>,<assoc>,<latency>[,inclusive|exclusive|nine]"
+bool parseLevelConfig(const char *arg, LevelConfig &level);
+const char *inclusionPolicyName(InclusionPolicy inclusion);
+// Number of sets a level of this size has with the given block size; 0 if
+// the size does not divide into a power-of-two number of sets
+uint32_t levelSets(const LevelConfig &level, uint32_t block_offset_bits);
+
+void initHierarchy(MemoryHierarchy &hierarchy, const std::vector<LevelConfig> &levels, uint32_t block_offset_bits,
+                   uint32_t memory_latency);
+
+struct Simulator;
+
+// Latency of fetching the block holding addr from below the L1s
+uint32_t readBlock(Simulator &sim, uint32_t addr);
+// Latency of writing a dirty L1 line back below the L1s
+uint32_t writeBackBlock(Simulator &sim, uint32_t addr);
+// An L1 dropped a clean copy of the block (an exclusive L2 takes it in)
+void dropCleanBlock(Simulator &sim, uint32_t addr);
+
+#endif
@@ -7,177 +7,64 @@
 #include <cstring>
 #include <sstream>
 #include <getopt.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <iomanip>
-#include "cache.hpp"
-#include "bus.hpp"
+#include "simulator.hpp"
+#include "replacement.hpp"
+#include "sweep.hpp"
+#include "stackdist.hpp"
 using namespace std;
-// Global variables
-std::vector<Cache> caches(4); // Four cores
-Stats global_stats;
-uint32_t current_cycle = 0;
-std::vector<std::vector<std::pair<char, uint32_t>>> traces(4);
 
-// Main simulation loop
-void simulate()
-{
-    std::vector<size_t> trace_indices(4, 0);
-    bool all_done;
-
-    while (true)
-    {
-        // Process cores
-        all_done = true;
-        for (int core = 0; core < 4; ++core)
-        {
-            if (trace_indices[core] < traces[core].size())
-            {
-                all_done = false;
-                // Check if the core is ready to process a new reference
-                if (caches[core].stall_cycles == 0)
-                {
-                    // Always try to process the reference - if it's a hit, it will complete
-                    // If it's a miss and the bus is busy, it will be stalled
-                    char op = traces[core][trace_indices[core]].first;
-                    uint32_t addr = traces[core][trace_indices[core]].second;
-
-                    // Parse the address to check if it's a hit
-                    uint32_t tag, set_index, block_offset;
-                    parseAddress(addr, caches[core].set_index_bits, caches[core].block_offset_bits, tag, set_index, block_offset);
-                    auto &set = caches[core].sets[set_index];
-
-                    // Check if it's a hit
-                    bool hit = false;
-                    int hit_index = -1;
-                    for (size_t i = 0; i < set.size(); ++i)
-                    {
-                        if (set[i].state != INVALID && set[i].tag == tag)
-                        {
-                            hit = true;
-                            hit_index = i;
-                            break;
-                        }
-                    }
-
-                    // If it's a hit, process it regardless of bus state
-                    // If it's a write hit to SHARED, we need the bus, so check bus state
-                    bool is_write = (op == 'W');
-                    if (hit && !(is_write && set[hit_index].state == SHARED))
-                    {
-                        // Process the hit (not a write to SHARED state)
-                        if (is_write)
-                        {
-                            caches[core].write_count++;
-                            set[hit_index].state = MODIFIED;
-                        }
-                        else
-                        {
-                            caches[core].read_count++;
-                        }
-                        updateLRU(set, hit_index);
-                        trace_indices[core]++;
-                        // For a hit, execution takes just 1 cycle
-                        caches[core].hit_cycles++;
-                    }
-                    // If it's a miss or a write hit to SHARED, we need the bus
-                    else if (bus_busy_cycles == 0 && bus_queue.empty())
-                    {
-                        // For a miss or write hit to SHARED, execution will take additional cycles
-                        // These cycles will be accounted for in processReference and handleMiss
-                        processReference(core, op, addr);
-                        trace_indices[core]++;
-                    }
-                    else
-                    {
-                        // Bus is busy but core has a pending request that needs the bus
-                        // Count as idle cycle and stall the core until bus is available
-                        caches[core].idle_cycles++;
-                        // caches[core].stall_cycles = 1; // Stall for at least one cycle, will be reset when bus becomes available
-                    }
-                }
-                else if (caches[core].stall_cycles > 0)
-                { // the core is in undergoing a bus command.
-                    caches[core].stall_cycles--;
-                    // Count this as an idle cycle since the core is waiting for a request to complete
-                    // caches[core].idle_cycles++;
-                }
-            }
-        }
-        if (!bus_queue.empty() || bus_busy_cycles > 0)
-        {
-            all_done = false;
-        }
-
-        if (all_done)
-            break;
-
-        // Process bus transactions first
-        if (bus_busy_cycles == 0 && !bus_queue.empty())
-        {
-            BusRequest req = bus_queue.front();
-            bus_queue.pop();
-            bus_transactions++;
-            // Special handling: if it is a writeback eviction request
-
-            uint32_t tag, set_index, block_offset;
-            parseAddress(req.addr, caches[req.core].set_index_bits, caches[req.core].block_offset_bits, tag, set_index, block_offset);
-            auto &set = caches[req.core].sets[set_index];
-            bool hit = false;
-            for (size_t i = 0; i < set.size(); ++i)
-            {
-                if (set[i].state != INVALID && set[i].tag == tag)
-                {
-                    hit = true;
-                    break;
-                }
-            }
-
-            bool shared = hit ? true : false; // if a hit, it must be write hit at SHARED to be in the bus.
-            bool supplied = false;
-            snoopBus(req.core, req.addr, req.is_write, shared, supplied);
-
-            caches[req.core].stall_cycles = 0;
+enum LongOption { OPT_COHERENCE = 256, OPT_HOP_LATENCY, OPT_DIR_LATENCY, OPT_MEM_LATENCY, OPT_GENERIC, OPT_L2, OPT_L3, OPT_BUS, OPT_OUTSTANDING, OPT_ARBITRATION, OPT_MSHRS, OPT_PREFETCH, OPT_PREFETCH_DEGREE, OPT_THREADS, OPT_TIMESERIES, OPT_INTERVAL, OPT_INTERVAL_REFS, OPT_STACK_DISTANCE, OPT_SAMPLE, OPT_CHECKPOINT_DIR, OPT_RESUME, OPT_PROTOCOL, OPT_SHARING_PROFILE, OPT_PIPELINE };
 
-            if (!hit)
-                handleMiss(req.core, req.addr, req.is_write, set_index, tag);
-
-            // bus_busy_cycles = supplied ? 2 * (caches[0].block_size/4) : 100;
-            if (hit)
-            { // If a write hit at SHARED then takes one cycle to invalidate (1 for hit)
-                bus_busy_cycles = 1;
-            }
-            else if (supplied)
-            { // if miss which gets data from cache, then 2N
-                // Cache-to-cache transfer
-                caches[req.core].stall_cycles += 2 * (caches[0].block_size / 4) - 1; //-1 because in this very cycle, it will start getting executed, so this cycle counts too
-                bus_busy_cycles = 2 * (caches[0].block_size / 4);                    // For bus, we will subtract 1 before the end of this cycle (below), so we don't need to do -1 here
-            }
-            else
-            { // miss with memory transfer, then 100
-                // Memory access
-                caches[req.core].stall_cycles += 100 - 1;
-                bus_busy_cycles = 100;
-            }
-
-            current_initiator = req.core;
-        }
-
-        // Advance cycles
-        current_cycle++;
-        if (bus_busy_cycles > 0)
-            bus_busy_cycles--;
-    }
-
-    global_stats.total_cycles = current_cycle;
-}
+static const struct option long_options[] = {
+    {"coherence", required_argument, nullptr, OPT_COHERENCE},
+    {"hop-latency", required_argument, nullptr, OPT_HOP_LATENCY},
+    {"dir-latency", required_argument, nullptr, OPT_DIR_LATENCY},
+    {"mem-latency", required_argument, nullptr, OPT_MEM_LATENCY},
+    {"generic", no_argument, nullptr, OPT_GENERIC},
+    {"l2", required_argument, nullptr, OPT_L2},
+    {"l3", required_argument, nullptr, OPT_L3},
+    {"bus", required_argument, nullptr, OPT_BUS},
+    {"outstanding", required_argument, nullptr, OPT_OUTSTANDING},
+    {"arbitration", required_argument, nullptr, OPT_ARBITRATION},
+    {"mshrs", required_argument, nullptr, OPT_MSHRS},
+    {"prefetch", required_argument, nullptr, OPT_PREFETCH},
+    {"prefetch-degree", required_argument, nullptr, OPT_PREFETCH_DEGREE},
+    {"threads", required_argument, nullptr, OPT_THREADS},
+    {"timeseries", required_argument, nullptr, OPT_TIMESERIES},
+    {"interval", required_argument, nullptr, OPT_INTERVAL},
+    {"interval-refs", required_argument, nullptr, OPT_INTERVAL_REFS},
+    {"stack-distance", no_argument, nullptr, OPT_STACK_DISTANCE},
+    {"sample", required_argument, nullptr, OPT_SAMPLE},
+    {"checkpoint-dir", required_argument, nullptr, OPT_CHECKPOINT_DIR},
+    {"resume", required_argument, nullptr, OPT_RESUME},
+    {"protocol", required_argument, nullptr, OPT_PROTOCOL},
+    {"sharing-profile", required_argument, nullptr, OPT_SHARING_PROFILE},
+    {"pipeline", no_argument, nullptr, OPT_PIPELINE},
+    {nullptr, 0, nullptr, 0},
+};
 
 int main(int argc, char *argv[])
 {
     std::string trace_name, outfilename;
     int set_index_bits = 0, assoc = 0, block_bits = 0;
+    std::vector<int> set_bits_list, assoc_list, block_bits_list;
+    SimulatorConfig config;
+    LevelConfig l2, l3;
+    bool has_l2 = false, has_l3 = false;
+    std::string timeseries_file;
+    uint64_t interval = 10000;
+    SampleUnit interval_unit = SAMPLE_CYCLES;
+    bool stack_distance = false;
+    std::string resume_file;
+    std::vector<CoherenceProtocol> protocols;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
 
     // Parse command line arguments
     int opt;
-    while ((opt = getopt(argc, argv, "t:s:E:b:o:h")) != -1)
+    while ((opt = getopt_long(argc, argv, "t:s:E:b:o:p:r:S:j:ch", long_options, nullptr)) != -1)
     {
         switch (opt)
         {
@@ -185,19 +72,201 @@ int main(int argc, char *argv[])
             trace_name = optarg;
             break;
         case 's':
-            set_index_bits = atoi(optarg);
-            break;
         case 'E':
-            assoc = atoi(optarg);
-            break;
         case 'b':
-            block_bits = atoi(optarg);
+        {
+            // A range or list of values turns the run into a parameter sweep
+            std::vector<int> &values = opt == 's' ? set_bits_list : opt == 'E' ? assoc_list : block_bits_list;
+            if (!parseValueList(optarg, values))
+            {
+                std::cerr << "Invalid value for -" << (char)opt << ": " << optarg << "\n";
+                return 1;
+            }
+            for (int value : values)
+            {
+                if (opt == 'E' && (value < 1 || (uint32_t)value > MAX_ASSOC))
+                {
+                    std::cerr << "Associativity must be between 1 and " << MAX_ASSOC << "\n";
+                    return 1;
+                }
+                if (opt != 'E' && value < 0)
+                {
+                    std::cerr << "Value for -" << (char)opt << " must not be negative\n";
+                    return 1;
+                }
+            }
+            (opt == 's' ? set_index_bits : opt == 'E' ? assoc : block_bits) = values[0];
+            break;
+        }
+        case 'j':
+            jobs = atoi(optarg);
             break;
         case 'o':
             outfilename = optarg;
             break;
+        case 'p':
+            config.num_cores = atoi(optarg);
+            if (config.num_cores < 1 || config.num_cores > MAX_CORES)
+            {
+                std::cerr << "Number of cores must be between 1 and " << MAX_CORES << "\n";
+                return 1;
+            }
+            break;
+        case 'r':
+            if (!parseReplacementPolicy(optarg, config.replacement))
+            {
+                std::cerr << "Unknown replacement policy " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case 'S':
+            config.seed = strtoull(optarg, nullptr, 0);
+            break;
+        case 'c':
+            config.event_driven = false;
+            break;
+        case OPT_COHERENCE:
+            if (strcmp(optarg, "snoop") == 0)
+                config.coherence_mode = COHERENCE_SNOOP;
+            else if (strcmp(optarg, "directory") == 0)
+                config.coherence_mode = COHERENCE_DIRECTORY;
+            else
+            {
+                std::cerr << "Unknown coherence mode " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case OPT_HOP_LATENCY:
+            config.directory_config.hop_latency = atoi(optarg);
+            break;
+        case OPT_DIR_LATENCY:
+            config.directory_config.lookup_latency = atoi(optarg);
+            break;
+        case OPT_MEM_LATENCY:
+            config.directory_config.memory_latency = atoi(optarg);
+            break;
+        case OPT_GENERIC:
+            config.fixed_geometries = false;
+            break;
+        case OPT_L2:
+        case OPT_L3:
+            if (!parseLevelConfig(optarg, opt == OPT_L2 ? l2 : l3))
+            {
+                std::cerr << "Invalid cache level " << optarg << ", expected <size KB>,<assoc>,<latency>[,inclusive|exclusive|nine]\n";
+                return 1;
+            }
+            if ((opt == OPT_L2 ? l2 : l3).assoc < 1 || (opt == OPT_L2 ? l2 : l3).assoc > MAX_ASSOC)
+            {
+                std::cerr << "Associativity must be between 1 and " << MAX_ASSOC << "\n";
+                return 1;
+            }
+            (opt == OPT_L2 ? has_l2 : has_l3) = true;
+            break;
+        case OPT_BUS:
+            if (!parseBusMode(optarg, config.bus.mode))
+            {
+                std::cerr << "Unknown bus model " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case OPT_OUTSTANDING:
+            if (atoi(optarg) < 1)
+            {
+                std::cerr << "Outstanding requests must be at least 1\n";
+                return 1;
+            }
+            config.bus.max_outstanding = atoi(optarg);
+            break;
+        case OPT_MSHRS:
+            if (atoi(optarg) < 0)
+            {
+                std::cerr << "Number of MSHRs cannot be negative\n";
+                return 1;
+            }
+            config.mshrs = atoi(optarg);
+            break;
+        case OPT_PREFETCH:
+            if (!parsePrefetcher(optarg, config.prefetch.kind))
+            {
+                std::cerr << "Unknown prefetcher " << optarg << "\n";
+                return 1;
+            }
+            break;
+        case OPT_PREFETCH_DEGREE:
+            if (atoi(optarg) < 1 || atoi(optarg) > 64)
+            {
+                std::cerr << "Prefetch degree must be between 1 and 64\n";
+                return 1;
+            }
+            config.prefetch.degree = atoi(optarg);
+            break;
+        case OPT_THREADS:
+            if (atoi(optarg) < 1)
+            {
+                std::cerr << "Number of threads must be at least 1\n";
+                return 1;
+            }
+            config.threads = atoi(optarg);
+            break;
+        case OPT_TIMESERIES:
+            timeseries_file = optarg;
+            break;
+        case OPT_INTERVAL:
+        case OPT_INTERVAL_REFS:
+            interval = strtoull(optarg, nullptr, 10);
+            if (interval < 1)
+            {
+                std::cerr << "Sampling interval must be at least 1\n";
+                return 1;
+            }
+            interval_unit = opt == OPT_INTERVAL ? SAMPLE_CYCLES : SAMPLE_REFERENCES;
+            break;
+        case OPT_STACK_DISTANCE:
+            stack_distance = true;
+            break;
+        case OPT_SAMPLE:
+            if (!parseSamplingConfig(optarg, config.sampling))
+            {
+                std::cerr << "Invalid sampling " << optarg << ", expected <period>,<warmup>,<window> with warmup + window <= period and window >= 1\n";
+                return 1;
+            }
+            break;
+        case OPT_CHECKPOINT_DIR:
+            config.sampling.checkpoint_dir = optarg;
+            mkdir(optarg, 0755);
+            break;
+        case OPT_RESUME:
+            resume_file = optarg;
+            break;
+        case OPT_PROTOCOL:
+            // Several protocols turn the run into a sweep, like -s/-E/-b lists
+            if (!parseCoherenceProtocols(optarg, protocols))
+            {
+                std::cerr << "Unknown coherence protocol " << optarg << ", expected mesi, moesi, mesif, a list of them or all\n";
+                return 1;
+            }
+            config.protocol = protocols[0];
+            break;
+        case OPT_SHARING_PROFILE:
+            if (atoi(optarg) < 1)
+            {
+                std::cerr << "Sharing profile must list at least 1 block\n";
+                return 1;
+            }
+            config.sharing_top = atoi(optarg);
+            break;
+        case OPT_PIPELINE:
+            config.pipeline = true;
+            break;
+        case OPT_ARBITRATION:
+            if (!parseBusArbitration(optarg, config.bus.arbitration))
+            {
+                std::cerr << "Unknown bus arbitration " << optarg << "\n";
+                return 1;
+            }
+            break;
         case 'h':
-            std::cout << "./L1simulate -t <tracefile> -s <set_index_bits> -E <associativity> -b <block_bits> -o <outfilename>\n";
+            std::cout << "./L1simulate -t <tracefile> -s <set_index_bits> -E <associativity> -b <block_bits> -o <outfilename> [-p <cores>] [-j <jobs>] [-r lru|lru-counter|fifo|plru|srrip|brrip|random] [-S <seed>] [-c] [--coherence snoop|directory] [--protocol mesi|moesi|mesif[,...]|all] [--sharing-profile <N>] [--hop-latency <n>] [--dir-latency <n>] [--mem-latency <n>] [--generic] [--l2 <KB>,<assoc>,<latency>[,inclusive|exclusive|nine]] [--l3 ...] [--bus blocking|split] [--outstanding <n>] [--arbitration fifo|rr|priority] [--mshrs <n>] [--prefetch none|next|stride|stream] [--prefetch-degree <n>] [--threads <n>] [--pipeline] [--timeseries <file.csv> [--interval <cycles> | --interval-refs <references>]] [--stack-distance] [--sample <period>,<warmup>,<window> [--checkpoint-dir <dir>] [--resume <checkpoint>]]\n";
             return 0;
         default:
             std::cerr << "Invalid option\n";
@@ -205,105 +274,198 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Initialize caches
-    for (int i = 0; i < 4; ++i)
+    config.set_index_bits = set_index_bits;
+    config.assoc = assoc;
+    config.block_bits = block_bits;
+
+    if (config.threads > 1 && (config.coherence_mode != COHERENCE_SNOOP || config.mshrs || config.prefetch.kind != PREFETCH_NONE))
     {
-        caches[i].num_sets = 1 << set_index_bits;
-        caches[i].assoc = assoc;
-        caches[i].block_size = 1 << block_bits;
-        caches[i].set_index_bits = set_index_bits;
-        caches[i].block_offset_bits = block_bits;
-        caches[i].tag_bits = 32 - set_index_bits - block_bits;
-        caches[i].sets.resize(caches[i].num_sets, std::vector<CacheLine>(assoc));
+        std::cerr << "--threads needs the snooping bus with blocking L1s and no prefetcher\n";
+        return 1;
     }
-
-    // Read trace files
-
-    for (int i = 0; i < 4; ++i)
+    if (config.coherence_mode == COHERENCE_DIRECTORY && (config.bus.mode == BUS_SPLIT || config.mshrs || config.prefetch.kind != PREFETCH_NONE))
+    {
+        std::cerr << "--bus split, --mshrs and --prefetch need the snooping bus; the directory has no bus and blocking L1s\n";
+        return 1;
+    }
+    if (config.protocol != PROTOCOL_MESI || protocols.size() > 1)
     {
-        std::string filename = trace_name + "_proc" + std::to_string(i) + ".trace";
-        std::ifstream file(filename);
-        if (!file)
+        if (config.coherence_mode != COHERENCE_SNOOP)
         {
-            std::cerr << "Cannot open " << filename << "\n";
+            std::cerr << "--protocol needs the snooping bus; the directory runs MESI\n";
             return 1;
         }
-        std::string line;
-        while (std::getline(file, line))
+    }
+    if (protocols.empty())
+        protocols.push_back(config.protocol);
+    if (config.pipeline && (config.threads > 1 || !config.sampling.checkpoint_dir.empty() || !resume_file.empty()))
+    {
+        std::cerr << "--pipeline cannot be used with --threads, --checkpoint-dir or --resume, which need the traces' file positions\n";
+        return 1;
+    }
+    if (config.sharing_top && config.coherence_mode != COHERENCE_SNOOP)
+    {
+        std::cerr << "--sharing-profile needs the snooping bus\n";
+        return 1;
+    }
+    if (config.sharing_top && !resume_file.empty())
+    {
+        std::cerr << "--sharing-profile cannot be used with --resume; checkpoints do not hold the profile\n";
+        return 1;
+    }
+    if (!timeseries_file.empty())
+    {
+        if (config.coherence_mode != COHERENCE_SNOOP)
+        {
+            std::cerr << "--timeseries needs the snooping bus\n";
+            return 1;
+        }
+        config.timeseries.interval = interval;
+        config.timeseries.unit = interval_unit;
+    }
+    if (config.sampling.period)
+    {
+        if (config.coherence_mode != COHERENCE_SNOOP || has_l2 || !timeseries_file.empty())
+        {
+            std::cerr << "--sample needs the snooping bus without shared levels or --timeseries\n";
+            return 1;
+        }
+    }
+    else if (!config.sampling.checkpoint_dir.empty() || !resume_file.empty())
+    {
+        std::cerr << "--checkpoint-dir and --resume need --sample\n";
+        return 1;
+    }
+    if (has_l3 && !has_l2)
+    {
+        std::cerr << "--l3 needs an --l2\n";
+        return 1;
+    }
+    if (has_l2)
+        config.levels.push_back(l2);
+    if (has_l3)
+        config.levels.push_back(l3);
+    if (set_bits_list.empty())
+        set_bits_list.push_back(set_index_bits);
+    if (assoc_list.empty())
+        assoc_list.push_back(assoc);
+    if (block_bits_list.empty())
+        block_bits_list.push_back(block_bits);
+    // Tags and set indices come from 32-bit addresses
+    for (int sb : set_bits_list)
+    {
+        for (int b : block_bits_list)
         {
-            std::istringstream iss(line);
-            char op;
-            uint32_t addr;
-            if (!(iss >> op >> std::hex >> addr))
+            if (sb + b > 31)
             {
-                std::cerr << "Invalid trace entry in " << filename << ": " << line << "\n";
+                std::cerr << "Set index bits plus block bits must be at most 31, got " << sb << " + " << b << "\n";
                 return 1;
             }
-            // std::cout << "Core " << i << ": op=" << op << ", addr=0x" << std::hex << addr << "\n";
-            traces[i].emplace_back(op, addr);
         }
     }
-    cout << "Trace files loaded successfully.\n";
-    // Run simulation
-    simulate();
-    cout << "Simulation completed.\n";
-    // Write output
-    cout << "Simulation completed.\n";
-
-    //---------------------------------- writing back M states
-    for (int core=0 ; core<4 ; core++) {
-        for(uint32_t i=0 ; i < caches[core].assoc ; i++) {
-            for (uint32_t j=0 ; j<caches[core].num_sets ; j++) {
-                if (caches[core].sets[i][j].state == MODIFIED) {
-                    caches[core].memory_cycles += 100;
-                    global_stats.total_cycles += 100;
-                }
+    for (size_t i = 0; i < config.levels.size(); ++i)
+    {
+        for (int b : block_bits_list)
+        {
+            if (levelSets(config.levels[i], b) == 0)
+            {
+                std::cerr << "L" << i + 2 << " size " << config.levels[i].size_kb << " KB with " << config.levels[i].assoc
+                          << " ways does not give a power-of-two number of " << (1 << b) << "-byte sets\n";
+                return 1;
             }
         }
     }
-    //----------------------------------
-
 
-    // Write output
+    if (config.pipeline && (stack_distance || set_bits_list.size() > 1 || assoc_list.size() > 1 || block_bits_list.size() > 1 || protocols.size() > 1))
+    {
+        std::cerr << "--pipeline cannot be used with --stack-distance or a parameter sweep, which share the traces between runs\n";
+        return 1;
+    }
 
-    std::ofstream outfile(outfilename);
+    if (stack_distance)
+    {
+        if (config.replacement != REPL_LRU && config.replacement != REPL_LRU_COUNTER)
+        {
+            std::cerr << "--stack-distance models LRU replacement only\n";
+            return 1;
+        }
+        Simulator loader(config);
+        std::string failed;
+        if (!loader.openTraces(trace_name, &failed))
+        {
+            std::cerr << "Cannot open " << failed << "\n";
+            return 1;
+        }
+        cout << "Trace files loaded successfully.\n";
+        return runStackDistance(config, loader.traces, set_bits_list, assoc_list, block_bits_list, jobs, outfilename);
+    }
 
-    // Print simulation parameters
-    outfile << "Simulation Parameters:\n";
-    outfile << "Trace Prefix: " << trace_name << "\n";
-    outfile << "Set Index Bits: " << set_index_bits << "\n";
-    outfile << "Associativity: " << assoc << "\n";
-    outfile << "Block Bits: " << block_bits << "\n";
-    outfile << "Block Size (Bytes): " << (1 << block_bits) << "\n";
-    outfile << "Number of Sets: " << (1 << set_index_bits) << "\n";
-    outfile << "Cache Size (KB per core): " << std::fixed << std::setprecision(2) << ((1 << set_index_bits) * assoc * (1 << block_bits)) / 1024.0 << "\n";
-    outfile << "MESI Protocol: Enabled\n";
-    outfile << "Write Policy: Write-back, Write-allocate\n";
-    outfile << "Replacement Policy: LRU\n";
-    outfile << "Bus: Central snooping bus\n\n";
+    if (set_bits_list.size() > 1 || assoc_list.size() > 1 || block_bits_list.size() > 1 || protocols.size() > 1)
+    {
+        if (!timeseries_file.empty() || config.sampling.period || config.sharing_top)
+        {
+            std::cerr << "--timeseries, --sample and --sharing-profile cannot be used with a parameter sweep\n";
+            return 1;
+        }
+        // Open the traces once; every configuration reads the same mappings
+        Simulator loader(config);
+        std::string failed;
+        if (!loader.openTraces(trace_name, &failed))
+        {
+            std::cerr << "Cannot open " << failed << "\n";
+            return 1;
+        }
+        cout << "Trace files loaded successfully.\n";
+        return runSweep(config, loader.traces, set_bits_list, assoc_list, block_bits_list, protocols, jobs, outfilename);
+    }
 
-    // Print per-core statistics
-    for (int i = 0; i < 4; ++i)
+    // Initialize caches and read trace files
+    Simulator sim(config);
+    profile_current = &sim.profile;
+    std::string failed;
+    bool opened;
     {
-        outfile << "Core " << i << " Statistics:\n";
-        outfile << "Total Instructions: " << (caches[i].read_count + caches[i].write_count) << "\n";
-        outfile << "Total Reads: " << caches[i].read_count << "\n";
-        outfile << "Total Writes: " << caches[i].write_count << "\n";
-        outfile << "Total Execution Cycles: " << (caches[i].hit_cycles + caches[i].memory_cycles) << "\n";
-        outfile << "Idle Cycles: " << caches[i].idle_cycles << "\n";
-        outfile << "Cache Misses: " << caches[i].miss_count << "\n";
-        outfile << "Cache Miss Rate: " << std::fixed << std::setprecision(5) << (double)caches[i].miss_count / (caches[i].read_count + caches[i].write_count) * 100 << "%\n";
-        outfile << "Cache Evictions: " << caches[i].eviction_count << "\n";
-        outfile << "Writebacks: " << caches[i].writeback_count << "\n";
-        outfile << "Bus Invalidations: " << caches[i].invalidation_count << "\n";
-        outfile << "Data Traffic (Bytes): " << caches[i].data_traffic << "\n\n";
+        PROFILE_SCOPE(PHASE_LOAD);
+        opened = sim.openTraces(trace_name, &failed);
     }
+    if (!opened)
+    {
+        std::cerr << "Cannot open " << failed << "\n";
+        return 1;
+    }
+    cout << "Trace files loaded successfully.\n";
+    if (!timeseries_file.empty() && !openTimeSeries(sim, timeseries_file))
+    {
+        std::cerr << "Cannot write " << timeseries_file << "\n";
+        return 1;
+    }
+    if (!resume_file.empty())
+    {
+        std::string error;
+        if (!loadCheckpoint(sim, resume_file, error))
+        {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        cout << "Resumed from sample point " << sim.sampling.sample_point << ".\n";
+    }
+
+    // Run simulation
+    sim.run();
+    cout << "Simulation completed.\n";
+    // Write output
+    cout << "Simulation completed.\n";
 
-    // Print overall bus summary
-    outfile << "Overall Bus Summary:\n";
-    outfile << "Total Bus Transactions: " << bus_transactions << "\n";
-    outfile << "Total Bus Traffic (Bytes): " << global_stats.bus_data_traffic << "\n";
-    outfile << "Maximum Execution Time (cycles): " << global_stats.total_cycles << "\n";
+    std::ofstream outfile(outfilename);
+    {
+        PROFILE_SCOPE(PHASE_REPORT);
+        sim.writeReport(outfile, trace_name);
+        outfile.flush();
+    }
+#ifdef L1SIM_PROFILE
+    std::ofstream profile_file(outfilename + ".profile.json");
+    sim.writeProfile(profile_file);
+#endif
 
     return 0;
 }
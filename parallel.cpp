@@ -0,0 +1,116 @@
+#include "parallel.hpp"
+#include "replacement.hpp"
+
+template <class Policy, class Geometry>
+HitRunner<Policy, Geometry>::HitRunner(Simulator &sim, int threads)
+    : sim(sim), threads(threads < sim.num_cores ? threads : sim.num_cores), probes(sim.num_cores), generation(0), finished(0)
+{
+    if (this->threads < 1)
+        this->threads = 1;
+    for (int i = 0; i < sim.num_cores; ++i)
+        probes[i].share(sim.traces[i]);
+    for (int t = 1; t < this->threads; ++t)
+        workers.emplace_back(&HitRunner::work, this, t);
+}
+
+template <class Policy, class Geometry>
+HitRunner<Policy, Geometry>::~HitRunner()
+{
+    run(JOB_STOP);
+    for (auto &t : workers)
+        t.join();
+}
+
+// Publish the job, do this thread's share and wait for the workers' shares
+template <class Policy, class Geometry>
+void HitRunner<Policy, Geometry>::run(Job next)
+{
+    job = next;
+    finished.store(0, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    if (next == JOB_STOP)
+        return;
+    runShare(0);
+    while (finished.load(std::memory_order_acquire) < (int)workers.size())
+        std::this_thread::yield();
+}
+
+template <class Policy, class Geometry>
+void HitRunner<Policy, Geometry>::work(int thread)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        uint64_t now;
+        while ((now = generation.load(std::memory_order_acquire)) == seen)
+            std::this_thread::yield();
+        seen = now;
+        if (job == JOB_STOP)
+            return;
+        runShare(thread);
+        finished.fetch_add(1, std::memory_order_release);
+    }
+}
+
+// Each thread always owns the same cores, so their caches stay on its host core
+template <class Policy, class Geometry>
+void HitRunner<Policy, Geometry>::runShare(int thread)
+{
+    for (size_t i = 0; i < cores->size(); ++i)
+    {
+        int core = (*cores)[i];
+        if (core % threads != thread)
+            continue;
+        Cache &cache = sim.caches[core];
+        uint32_t tag, set_index, block_offset;
+        if (job == JOB_SCAN)
+        {
+            TraceReader &probe = probes[core];
+            probe.seek(sim.traces[core]);
+            uint32_t n = 0;
+            while (n < count && !probe.done())
+            {
+                const TraceRef &ref = probe.current();
+                Geometry::split(cache, ref.addr, tag, set_index, block_offset);
+                int way = Geometry::findLine(cache, set_index, tag);
+                if (way < 0 || (ref.op == 'W' && !isWritable(cache.state(set_index, way))))
+                    break;
+                n++;
+                probe.advance();
+            }
+            (*hits)[i] = n;
+        }
+        else
+        {
+            TraceReader &trace = sim.traces[core];
+            for (uint32_t n = 0; n < count; ++n)
+            {
+                const TraceRef &ref = trace.current();
+                Geometry::split(cache, ref.addr, tag, set_index, block_offset);
+                retireHit<Policy>(cache, trace, ref.op == 'W', set_index, Geometry::findLine(cache, set_index, tag));
+            }
+        }
+    }
+}
+
+template <class Policy, class Geometry>
+void HitRunner<Policy, Geometry>::scan(const std::vector<int> &cores, uint32_t limit, std::vector<uint32_t> &hits)
+{
+    hits.resize(cores.size());
+    this->cores = &cores;
+    this->count = limit;
+    this->hits = &hits;
+    run(JOB_SCAN);
+}
+
+template <class Policy, class Geometry>
+void HitRunner<Policy, Geometry>::apply(const std::vector<int> &cores, uint32_t count)
+{
+    this->cores = &cores;
+    this->count = count;
+    run(JOB_APPLY);
+}
+
+#define INSTANTIATE_HIT_RUNNER_FOR(Policy, Geometry) template class HitRunner<Policy, Geometry>;
+#define INSTANTIATE_HIT_RUNNER(Policy) FOR_EACH_GEOMETRY(INSTANTIATE_HIT_RUNNER_FOR, Policy)
+FOR_EACH_REPLACEMENT_POLICY(INSTANTIATE_HIT_RUNNER)
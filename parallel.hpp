@@ -0,0 +1,86 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include "simulator.hpp"
+
+// Parallel engine for one simulation (--threads, snooping bus with blocking
+// L1s and no prefetcher). Cores only interact through bus grants, and a
+// grant can only happen once the bus is free and some core needs it. Until
+// then, each ready core that hits its own L1 touches nothing but its own
+// cache, counters and trace. The simulator therefore looks for windows of
+// cycles in which every ready core only hits and no grant can occur, and
+// has a HitRunner execute them. Cores are split across a pool of host threads
+// and synchronize through atomics only. A window is run in two phases:
+//   scan   each core counts, read-only, how many of its next references hit
+//   apply  each core executes the hits of the shortest count
+// The cycle ending the window goes back to the serial loop. Hits do not
+// change which later references hit, so the result is the serial one.
+
+// Longest window when no bus activity bounds it
+static const uint32_t PARALLEL_WINDOW = 4096;
+// Windows shorter than this do not pay for the handoff to the threads; after
+// one the simulator runs PARALLEL_BACKOFF loop iterations serially
+static const uint32_t PARALLEL_MIN_WINDOW = 32;
+static const uint32_t PARALLEL_BACKOFF = 256;
+
+// A reference that hits its own L1 without needing the bus: the serial
+// loop's hit path, shared by both engines
+template <class Policy>
+inline void retireHit(Cache &cache, TraceReader &trace, bool is_write, uint32_t set_index, int way)
+{
+    if (is_write)
+    {
+        cache.write_count++;
+        cache.setState(set_index, way, MODIFIED);
+    }
+    else
+    {
+        cache.read_count++;
+    }
+    Policy::touch(cache, set_index, way);
+    PROFILE_INCREMENT(cache.profile_replacement_updates);
+    trace.advance();
+    // For a hit, execution takes just 1 cycle
+    cache.hit_cycles++;
+}
+
+template <class Policy, class Geometry>
+class HitRunner {
+public:
+    HitRunner(Simulator &sim, int threads);
+    ~HitRunner();
+    HitRunner(const HitRunner &) = delete;
+    HitRunner &operator=(const HitRunner &) = delete;
+
+    // For each listed core, how many references from its current one, up
+    // to `limit`, hit its L1 without the bus (stops at the end of its trace)
+    void scan(const std::vector<int> &cores, uint32_t limit, std::vector<uint32_t> &hits);
+    // Execute the next `count` references of each listed core, all hits
+    void apply(const std::vector<int> &cores, uint32_t count);
+
+private:
+    enum Job { JOB_SCAN, JOB_APPLY, JOB_STOP };
+
+    Simulator &sim;
+    int threads;
+    std::vector<TraceReader> probes; // per-core read-ahead cursors for scans
+    std::vector<std::thread> workers;
+
+    // The current job, published by bumping generation
+    Job job = JOB_SCAN;
+    const std::vector<int> *cores = nullptr;
+    uint32_t count = 0;
+    std::vector<uint32_t> *hits = nullptr;
+    std::atomic<uint64_t> generation;
+    std::atomic<int> finished;
+
+    void run(Job next);
+    void work(int thread);
+    void runShare(int thread);
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "prefetch.hpp"
+#include "simulator.hpp"
+#include <cstring>
+
+bool parsePrefetcher(const char *name, PrefetcherKind &kind)
+{
+    if (strcmp(name, "none") == 0)
+        kind = PREFETCH_NONE;
+    else if (strcmp(name, "next") == 0)
+        kind = PREFETCH_NEXT_LINE;
+    else if (strcmp(name, "stride") == 0)
+        kind = PREFETCH_STRIDE;
+    else if (strcmp(name, "stream") == 0)
+        kind = PREFETCH_STREAM;
+    else
+        return false;
+    return true;
+}
+
+const char *prefetcherName(PrefetcherKind kind)
+{
+    switch (kind)
+    {
+    case PREFETCH_NONE:
+        return "none";
+    case PREFETCH_NEXT_LINE:
+        return "next-N-line";
+    case PREFETCH_STRIDE:
+        return "stride";
+    case PREFETCH_STREAM:
+        return "stream";
+    }
+    return "unknown";
+}
+
+void initPrefetcher(Prefetcher &prefetcher, size_t cache_lines)
+{
+    prefetcher.strides.assign(STRIDE_TABLE_SIZE, StrideEntry());
+    prefetcher.streams.assign(STREAM_COUNT, StreamEntry());
+    prefetcher.evicted_by_prefetch.assign(cache_lines, 0);
+}
+
+static void trainStride(Prefetcher &prefetcher, const PrefetchConfig &config, uint32_t block, uint32_t block_offset_bits,
+                        std::vector<uint32_t> &proposals)
+{
+    uint32_t region = (uint32_t)(((uint64_t)block << block_offset_bits) >> 12);
+    StrideEntry &entry = prefetcher.strides[region % STRIDE_TABLE_SIZE];
+    if (entry.region != region)
+    {
+        entry.region = region;
+        entry.last_block = block;
+        entry.stride = 0;
+        entry.confirmed = false;
+        return;
+    }
+    int32_t delta = (int32_t)(block - entry.last_block);
+    if (delta == 0)
+        return;
+    entry.confirmed = delta == entry.stride;
+    entry.stride = delta;
+    entry.last_block = block;
+    if (!entry.confirmed)
+        return;
+    for (uint32_t k = 1; k <= config.degree; ++k)
+        proposals.push_back(block + k * entry.stride);
+}
+
+// Propose the blocks of the stream up to `degree` ahead of `block`
+static void advanceStream(StreamEntry &stream, const PrefetchConfig &config, uint32_t block, std::vector<uint32_t> &proposals)
+{
+    stream.last_block = block;
+    uint32_t end = block + stream.direction * (int32_t)(config.degree + 1);
+    while ((int32_t)(end - stream.next_prefetch) * stream.direction > 0)
+    {
+        proposals.push_back(stream.next_prefetch);
+        stream.next_prefetch += stream.direction;
+    }
+}
+
+static void trainStream(Prefetcher &prefetcher, const PrefetchConfig &config, uint32_t block, std::vector<uint32_t> &proposals)
+{
+    prefetcher.stream_clock++;
+    StreamEntry *victim = &prefetcher.streams[0];
+    for (StreamEntry &stream : prefetcher.streams)
+    {
+        if (stream.valid)
+        {
+            int32_t distance = (int32_t)(block - stream.last_block) * stream.direction;
+            if (stream.confirmed && distance >= 1 && distance <= (int32_t)config.degree + 1)
+            {
+                // The accesses caught up with the stream; keep it ahead of them
+                stream.last_use = prefetcher.stream_clock;
+                if ((int32_t)(stream.next_prefetch - block) * stream.direction < 1)
+                    stream.next_prefetch = block + stream.direction;
+                advanceStream(stream, config, block, proposals);
+                return;
+            }
+            if (!stream.confirmed && (block == stream.last_block + 1 || block == stream.last_block - 1))
+            {
+                stream.confirmed = true;
+                stream.direction = block == stream.last_block + 1 ? 1 : -1;
+                stream.last_use = prefetcher.stream_clock;
+                stream.next_prefetch = block + stream.direction;
+                advanceStream(stream, config, block, proposals);
+                return;
+            }
+        }
+        if (!stream.valid || (victim->valid && stream.last_use < victim->last_use))
+            victim = &stream;
+    }
+    // No stream continues here: start a new one, replacing the least recently used
+    victim->valid = true;
+    victim->confirmed = false;
+    victim->last_block = block;
+    victim->last_use = prefetcher.stream_clock;
+}
+
+void trainPrefetcher(Prefetcher &prefetcher, const PrefetchConfig &config, uint32_t block, uint32_t block_offset_bits,
+                     std::vector<uint32_t> &proposals)
+{
+    switch (config.kind)
+    {
+    case PREFETCH_NONE:
+        break;
+    case PREFETCH_NEXT_LINE:
+        for (uint32_t k = 1; k <= config.degree; ++k)
+            proposals.push_back(block + k);
+        break;
+    case PREFETCH_STRIDE:
+        trainStride(prefetcher, config, block, block_offset_bits, proposals);
+        break;
+    case PREFETCH_STREAM:
+        trainStream(prefetcher, config, block, proposals);
+        break;
+    }
+}
+
+static bool prefetchQueued(const Simulator &sim, int core, uint32_t block)
+{
+    for (const BusRequest &req : sim.prefetch_queue)
+    {
+        if (req.core == core && req.addr >> sim.caches[core].block_offset_bits == block)
+            return true;
+    }
+    return false;
+}
+
+// Whether the core already holds the block or is fetching it
+static bool blockPresent(const Simulator &sim, int core, uint32_t block)
+{
+    const Cache &cache = sim.caches[core];
+    uint32_t tag, set_index, block_offset;
+    parseAddress(block << cache.block_offset_bits, cache.set_index_bits, cache.block_offset_bits, tag, set_index, block_offset);
+    if (cache.findLine(set_index, tag) >= 0)
+        return true;
+    for (const MSHR &m : cache.mshrs)
+    {
+        if (m.block == block)
+            return true;
+    }
+    return false;
+}
+
+static void trainAndQueue(Simulator &sim, int core, uint32_t block)
+{
+    Prefetcher &prefetcher = sim.prefetchers[core];
+    const Cache &cache = sim.caches[core];
+    prefetcher.proposals.clear();
+    trainPrefetcher(prefetcher, sim.config.prefetch, block, cache.block_offset_bits, prefetcher.proposals);
+    for (uint32_t proposal : prefetcher.proposals)
+    {
+        // Blocks wrapping past the top of the address space are not prefetched
+        if ((uint64_t)proposal << cache.block_offset_bits >> 32)
+            continue;
+        if (blockPresent(sim, core, proposal) || prefetchQueued(sim, core, proposal))
+        {
+            prefetcher.redundant++;
+            continue;
+        }
+        if (sim.prefetch_queue.size() >= (size_t)PREFETCH_QUEUE_PER_CORE * sim.num_cores)
+        {
+            prefetcher.dropped++;
+            continue;
+        }
+        sim.prefetch_queue.push_back({core, proposal << cache.block_offset_bits, false, false, sim.current_cycle});
+    }
+}
+
+void prefetchOnMiss(Simulator &sim, int core, uint32_t addr)
+{
+    Prefetcher &prefetcher = sim.prefetchers[core];
+    uint32_t block = addr >> sim.caches[core].block_offset_bits;
+
+    // The prefetch was proposed but never reached the bus: the demand fetches it instead
+    for (auto it = sim.prefetch_queue.begin(); it != sim.prefetch_queue.end(); ++it)
+    {
+        if (it->core == core && it->addr >> sim.caches[core].block_offset_bits == block)
+        {
+            prefetcher.late++;
+            sim.prefetch_queue.erase(it);
+            break;
+        }
+    }
+
+    uint32_t &evicted = prefetcher.evicted_by_prefetch[block % prefetcher.evicted_by_prefetch.size()];
+    if (evicted == block + 1)
+    {
+        prefetcher.polluting++;
+        evicted = 0;
+    }
+
+    trainAndQueue(sim, core, block);
+}
+
+uint32_t prefetchOnUse(Simulator &sim, int core, uint32_t line, uint32_t addr)
+{
+    Prefetcher &prefetcher = sim.prefetchers[core];
+    uint32_t block = addr >> sim.caches[core].block_offset_bits;
+    sim.caches[core].prefetched[line] = 0;
+    prefetcher.useful++;
+
+    uint32_t wait = 0;
+    for (size_t i = 0; i < prefetcher.inflight.size();)
+    {
+        if (prefetcher.inflight[i].first == block && prefetcher.inflight[i].second > sim.current_cycle)
+        {
+            prefetcher.late++;
+            wait = prefetcher.inflight[i].second - sim.current_cycle;
+        }
+        if (prefetcher.inflight[i].first == block || prefetcher.inflight[i].second <= sim.current_cycle)
+        {
+            prefetcher.inflight[i] = prefetcher.inflight.back();
+            prefetcher.inflight.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    trainAndQueue(sim, core, block);
+    return wait;
+}
+
+void prefetchEvicted(Simulator &sim, int core, uint32_t block)
+{
+    Prefetcher &prefetcher = sim.prefetchers[core];
+    prefetcher.evicted_by_prefetch[block % prefetcher.evicted_by_prefetch.size()] = block + 1;
+}
+
+bool nextPrefetch(Simulator &sim, BusRequest &req)
+{
+    while (!sim.prefetch_queue.empty())
+    {
+        req = sim.prefetch_queue.front();
+        sim.prefetch_queue.pop_front();
+        if (!blockPresent(sim, req.core, req.addr >> sim.caches[req.core].block_offset_bits))
+            return true;
+        sim.prefetchers[req.core].redundant++;
+    }
+    return false;
+}
+
+void prefetchIssued(Simulator &sim, const BusRequest &req, uint64_t ready, uint64_t bytes)
+{
+    Prefetcher &prefetcher = sim.prefetchers[req.core];
+    prefetcher.issued++;
+    prefetcher.bytes += bytes;
+    for (size_t i = 0; i < prefetcher.inflight.size();)
+    {
+        if (prefetcher.inflight[i].second <= sim.current_cycle)
+        {
+            prefetcher.inflight[i] = prefetcher.inflight.back();
+            prefetcher.inflight.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    prefetcher.inflight.push_back(std::make_pair(req.addr >> sim.caches[req.core].block_offset_bits, ready));
+}
@@ -0,0 +1,98 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+// Hardware prefetchers for the L1s (--prefetch, snooping bus only). Each
+// one trains on a core's demand misses and first hits on prefetched lines,
+// and proposes blocks to fetch. Prefetches wait in their own queue and are
+// granted the bus only when no demand request is waiting. They then snoop
+// and fill like read misses, so they cost the same bus time and traffic.
+//   next    the next `degree` blocks after a miss
+//   stride  per 4 KB region, the last block and block delta; once the same
+//           non-zero delta is seen twice, `degree` blocks along it
+//   stream  up to STREAM_COUNT ascending or descending block streams; a miss
+//           next to a stream's last block confirms it, and the stream then
+//           stays `degree` blocks ahead of the accesses
+
+enum PrefetcherKind { PREFETCH_NONE, PREFETCH_NEXT_LINE, PREFETCH_STRIDE, PREFETCH_STREAM };
+
+struct PrefetchConfig {
+    PrefetcherKind kind = PREFETCH_NONE;
+    uint32_t degree = 2;
+};
+
+static const int STRIDE_TABLE_SIZE = 16;
+static const int STREAM_COUNT = 4;
+static const int PREFETCH_QUEUE_PER_CORE = 16;
+
+struct StrideEntry {
+    uint32_t region = UINT32_MAX;
+    uint32_t last_block = 0;
+    int32_t stride = 0;
+    bool confirmed = false; // the stride repeated
+};
+
+struct StreamEntry {
+    bool valid = false;
+    bool confirmed = false;
+    int direction = 1;
+    uint32_t last_block = 0;     // most recent demand block on the stream
+    uint32_t next_prefetch = 0;  // first block not yet proposed
+    uint64_t last_use = 0;       // for LRU replacement of streams
+};
+
+// Per-core prefetcher state and statistics
+struct Prefetcher {
+    std::vector<StrideEntry> strides;
+    std::vector<StreamEntry> streams;
+    uint64_t stream_clock = 0;
+    // Blocks evicted by prefetch fills, direct-mapped, block + 1 (0 is empty).
+    // A demand miss on one of them counts the prefetch as polluting.
+    std::vector<uint32_t> evicted_by_prefetch;
+    // Granted prefetches whose data may still be on its way: block, arrival cycle
+    std::vector<std::pair<uint32_t, uint64_t>> inflight;
+    std::vector<uint32_t> proposals; // scratch for trainPrefetcher
+
+    uint64_t issued = 0;     // prefetches granted the bus
+    uint64_t useful = 0;     // prefetched lines later hit by a demand access
+    uint64_t late = 0;       // demand accesses that still waited: the data was on its way, or
+                             // the prefetch had not been granted the bus yet (then a miss)
+    uint64_t polluting = 0;  // demand misses on lines a prefetch had evicted
+    uint64_t unused = 0;     // prefetched lines evicted before any demand access
+    uint64_t redundant = 0;  // proposals dropped as already cached, queued or outstanding
+    uint64_t dropped = 0;    // proposals dropped on a full prefetch queue
+    uint64_t bytes = 0;      // bus bytes moved by prefetch fills
+};
+
+// Parse a --prefetch argument; false if the name is unknown
+bool parsePrefetcher(const char *name, PrefetcherKind &kind);
+const char *prefetcherName(PrefetcherKind kind);
+void initPrefetcher(Prefetcher &prefetcher, size_t cache_lines);
+
+// Train on a demand miss (or first hit on a prefetched line) to `block` and
+// append the blocks the prefetcher wants fetched
+void trainPrefetcher(Prefetcher &prefetcher, const PrefetchConfig &config, uint32_t block, uint32_t block_offset_bits,
+                     std::vector<uint32_t> &proposals);
+
+struct Simulator;
+struct BusRequest;
+
+// Hooks the snooping simulator calls when prefetching is enabled
+// A demand miss: late and polluting checks, then training
+void prefetchOnMiss(Simulator &sim, int core, uint32_t addr);
+// A demand hit on a line still marked as prefetched. Returns the cycles
+// until the prefetched data arrives, 0 if it already has.
+uint32_t prefetchOnUse(Simulator &sim, int core, uint32_t line, uint32_t addr);
+// A prefetch fill evicted the block
+void prefetchEvicted(Simulator &sim, int core, uint32_t block);
+// The next queued prefetch still worth the bus; false if none is left.
+// Prefetches for blocks the core has gained since are dropped on the way.
+bool nextPrefetch(Simulator &sim, BusRequest &req);
+// The prefetch was granted and moved `bytes` over the bus; its data arrives at `ready`
+void prefetchIssued(Simulator &sim, const BusRequest &req, uint64_t ready, uint64_t bytes);
+
+#endif
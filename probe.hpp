@@ -0,0 +1,53 @@
+#ifndef PROBE_HPP
+#define PROBE_HPP
+
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Set probe: the way among `ways` lines whose state is valid (non-zero) and
+// whose tag equals `tag`, or -1. Tags and states are the per-set runs of the
+// Cache arrays. Eight ways are compared per step with AVX2 when the build
+// enables it (make ARCHFLAGS=-mavx2), four with SSE2 otherwise on x86-64,
+// and the remainder one at a time. Vector loads never read past `ways`.
+inline int probeSet(const uint32_t *tags, const uint8_t *states, uint32_t ways, uint32_t tag)
+{
+    uint32_t i = 0;
+#if defined(__AVX2__)
+    const __m256i want8 = _mm256_set1_epi32(tag);
+    for (; i + 8 <= ways; i += 8)
+    {
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tags + i));
+        __m256i s = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(states + i)));
+        __m256i match = _mm256_andnot_si256(_mm256_cmpeq_epi32(s, _mm256_setzero_si256()), _mm256_cmpeq_epi32(t, want8));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i want4 = _mm_set1_epi32(tag);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= ways; i += 4)
+    {
+        int packed;
+        memcpy(&packed, states + i, sizeof(packed));
+        __m128i s = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tags + i));
+        __m128i match = _mm_andnot_si128(_mm_cmpeq_epi32(s, zero), _mm_cmpeq_epi32(t, want4));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(match));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < ways; ++i)
+    {
+        if (states[i] != 0 && tags[i] == tag)
+            return i;
+    }
+    return -1;
+}
+
+#endif
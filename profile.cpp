@@ -0,0 +1,73 @@
+#include "profile.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+thread_local Profile *profile_current = nullptr;
+static thread_local ProfileScope *active_scope = nullptr;
+
+uint64_t profileTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+const char *profilePhaseName(ProfilePhase phase)
+{
+    static const char *const names[PHASE_COUNT] = {"load", "simulate", "trace_parse", "snoop", "miss",
+                                                   "parallel_windows", "writeback", "report"};
+    return names[phase];
+}
+
+const char *profileCounterName(ProfileCounter counter)
+{
+    static const char *const names[COUNTER_COUNT] = {"loop_iterations", "bus_grants", "snoops", "miss_fills",
+                                                     "skips", "skipped_cycles", "parallel_windows", "parallel_cycles"};
+    return names[counter];
+}
+
+Profile::Profile() : start_ticks(profileTicks()), start_time(std::chrono::steady_clock::now())
+{
+}
+
+double Profile::seconds(uint64_t t) const
+{
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    uint64_t elapsed = profileTicks() - start_ticks;
+    return elapsed && wall > 0 ? t * (wall / elapsed) : 0.0;
+}
+
+void Profile::sampleRate(uint64_t references)
+{
+    if (references < next_rate_sample)
+        return;
+    ProfileRateSample sample;
+    sample.seconds = seconds(profileTicks() - start_ticks);
+    sample.references = references;
+    double since = rates.empty() ? sample.seconds : sample.seconds - rates.back().seconds;
+    uint64_t done = rates.empty() ? references : references - rates.back().references;
+    sample.rate = since > 0 ? done / since : 0.0;
+    rates.push_back(sample);
+    next_rate_sample = references - references % PROFILE_RATE_INTERVAL + PROFILE_RATE_INTERVAL;
+}
+
+ProfileScope::ProfileScope(ProfilePhase phase)
+    : profile(profile_current), phase(phase), parent(active_scope), start(profileTicks())
+{
+    active_scope = this;
+}
+
+ProfileScope::~ProfileScope()
+{
+    uint64_t elapsed = profileTicks() - start;
+    active_scope = parent;
+    if (parent)
+        parent->nested += elapsed;
+    if (!profile)
+        return;
+    profile->ticks[phase] += elapsed - nested;
+    profile->calls[phase]++;
+}
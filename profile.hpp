@@ -0,0 +1,108 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+// Instrumentation of the simulator itself, compiled in with make PROFILE=1
+// (which defines L1SIM_PROFILE). Without it every PROFILE_* macro expands
+// to nothing. With it:
+//   PROFILE_SCOPE(phase)      adds the scope's wall time to the phase, minus
+//                             the time of phases nested inside it
+//   PROFILE_COUNT(counter)    counts an event of the simulation on this thread
+//   PROFILE_INCREMENT(field)  increments a counter owned by one cache
+//   PROFILE_TICK(sim)         counts a simulation loop iteration, logging the
+//                             host rate now and then
+// Phases and counters go to the Profile of the simulation running on this
+// thread (profile_current). L1simulate writes it as JSON next to the -o file.
+
+enum ProfilePhase {
+    PHASE_LOAD,       // opening and mapping the traces
+    PHASE_SIMULATE,   // the simulation loop: hit path, arbitration, bookkeeping
+    PHASE_PARSE,      // decoding trace references
+    PHASE_SNOOP,      // snoopBus
+    PHASE_MISS,       // handleMiss, without its snoop
+    PHASE_PARALLEL,   // parallel hit windows, as seen by the simulating thread
+    PHASE_WRITEBACK,  // final writeback of dirty lines
+    PHASE_REPORT,     // writing the report
+    PHASE_COUNT
+};
+
+enum ProfileCounter {
+    COUNT_LOOP_ITERATIONS,
+    COUNT_BUS_GRANTS,
+    COUNT_SNOOPS,
+    COUNT_MISS_FILLS,
+    COUNT_SKIPS,            // event-driven fast-forwards
+    COUNT_SKIPPED_CYCLES,
+    COUNT_PARALLEL_WINDOWS,
+    COUNT_PARALLEL_CYCLES,
+    COUNTER_COUNT
+};
+
+// Host speed is logged every PROFILE_RATE_INTERVAL simulated references
+static const uint64_t PROFILE_RATE_INTERVAL = 1 << 20;
+
+struct ProfileRateSample {
+    double seconds;      // since the Simulator was created
+    uint64_t references; // references simulated so far
+    double rate;         // references per second over the last interval
+};
+
+struct Profile {
+    uint64_t ticks[PHASE_COUNT] = {};
+    uint64_t calls[PHASE_COUNT] = {};
+    uint64_t counts[COUNTER_COUNT] = {};
+    std::vector<ProfileRateSample> rates;
+    uint64_t next_rate_sample = PROFILE_RATE_INTERVAL;
+    // Tick counter calibration: ticks and wall time when the profile started
+    uint64_t start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+
+    Profile();
+    // Convert profile ticks to seconds, using the ticks counted since construction
+    double seconds(uint64_t ticks) const;
+    // Log the host rate once another PROFILE_RATE_INTERVAL references are done
+    void sampleRate(uint64_t references);
+};
+
+// Cheap monotonic tick counter: the time stamp counter on x86, else nanoseconds
+uint64_t profileTicks();
+const char *profilePhaseName(ProfilePhase phase);
+const char *profileCounterName(ProfileCounter counter);
+
+extern thread_local Profile *profile_current;
+
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfilePhase phase);
+    ~ProfileScope();
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    Profile *profile;
+    ProfilePhase phase;
+    ProfileScope *parent;
+    uint64_t start;
+    uint64_t nested = 0; // ticks spent in scopes opened inside this one
+};
+
+#ifdef L1SIM_PROFILE
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(phase)
+#define PROFILE_COUNT(counter) (profile_current ? (void)profile_current->counts[counter]++ : (void)0)
+#define PROFILE_ADD(counter, n) (profile_current ? (void)(profile_current->counts[counter] += (n)) : (void)0)
+#define PROFILE_INCREMENT(field) ((void)(field)++)
+#define PROFILE_TICK(sim) ((sim).profileTick())
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_COUNT(counter) ((void)0)
+#define PROFILE_ADD(counter, n) ((void)0)
+#define PROFILE_INCREMENT(field) ((void)0)
+#define PROFILE_TICK(sim) ((void)0)
+#endif
+
+#endif
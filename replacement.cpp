@@ -0,0 +1,90 @@
+#include "replacement.hpp"
+
+static const struct {
+    const char *name;
+    ReplacementPolicy policy;
+} policy_names[] = {
+    {"lru", REPL_LRU},
+    {"lru-counter", REPL_LRU_COUNTER},
+    {"fifo", REPL_FIFO},
+    {"plru", REPL_PLRU},
+    {"srrip", REPL_SRRIP},
+    {"brrip", REPL_BRRIP},
+    {"random", REPL_RANDOM},
+};
+
+bool parseReplacementPolicy(const char *name, ReplacementPolicy &policy)
+{
+    for (const auto &entry : policy_names)
+    {
+        if (strcmp(name, entry.name) == 0)
+        {
+            policy = entry.policy;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *replacementPolicyName(ReplacementPolicy policy)
+{
+    switch (policy)
+    {
+    case REPL_LRU:
+    case REPL_LRU_COUNTER:
+        return "LRU";
+    case REPL_FIFO:
+        return "FIFO";
+    case REPL_PLRU:
+        return "Tree-PLRU";
+    case REPL_SRRIP:
+        return "SRRIP";
+    case REPL_BRRIP:
+        return "BRRIP";
+    case REPL_RANDOM:
+        return "Random";
+    }
+    return "Unknown";
+}
+
+void initReplacement(Cache &cache, uint64_t seed)
+{
+    size_t lines = cache.tags.size();
+    // xorshift must not start from zero
+    cache.rng_state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+
+    switch (cache.replacement)
+    {
+    case REPL_LRU:
+    case REPL_FIFO:
+        // Every set starts as the list 0 (head) ... assoc-1 (tail)
+        cache.lru_prev.resize(lines);
+        cache.lru_next.resize(lines);
+        for (uint32_t set = 0; set < cache.num_sets; ++set)
+        {
+            for (uint32_t way = 0; way < cache.assoc; ++way)
+            {
+                cache.lru_prev[cache.line(set, way)] = way - 1;
+                cache.lru_next[cache.line(set, way)] = way + 1;
+            }
+        }
+        cache.lru_head.assign(cache.num_sets, 0);
+        cache.lru_tail.assign(cache.num_sets, cache.assoc - 1);
+        break;
+    case REPL_LRU_COUNTER:
+        cache.lru_counters.assign(lines, 0);
+        break;
+    case REPL_PLRU:
+        cache.plru_leaves = 1;
+        while (cache.plru_leaves < cache.assoc)
+            cache.plru_leaves <<= 1;
+        cache.plru_bits.assign((size_t)cache.num_sets * cache.plru_leaves, 0);
+        break;
+    case REPL_SRRIP:
+    case REPL_BRRIP:
+        cache.rrpv.assign(lines, RRPV_MAX);
+        break;
+    case REPL_RANDOM:
+        break;
+    }
+}
@@ -0,0 +1,214 @@
+#ifndef REPLACEMENT_HPP
+#define REPLACEMENT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include "cache.hpp"
+#include "geometry.hpp"
+
+// Replacement policies. Each one is a set of static hooks that the simulator
+// is instantiated with, so the hot loop calls them directly:
+//   init(cache)              allocate per-cache metadata
+//   touch(cache, set, way)   a hit on the line
+//   fill(cache, set, way)    a new line was brought into the way
+//   victim(cache, set)       pick a way to evict; only called on full sets
+// Invalid ways are always filled first, lowest way first (findVictim).
+
+// Parse a -r argument; false if the name is unknown
+bool parseReplacementPolicy(const char *name, ReplacementPolicy &policy);
+const char *replacementPolicyName(ReplacementPolicy policy);
+// Allocate the metadata the cache's policy needs
+void initReplacement(Cache &cache, uint64_t seed);
+
+// Per-set recency list shared by LRU and FIFO: move a way to the head
+inline void listMoveToFront(Cache &cache, uint32_t set_index, uint16_t way)
+{
+    uint16_t &head = cache.lru_head[set_index];
+    if (head == way)
+        return;
+    uint32_t base = set_index * cache.assoc;
+    uint16_t prev = cache.lru_prev[base + way];
+    uint16_t next = cache.lru_next[base + way];
+    cache.lru_next[base + prev] = next;
+    if (cache.lru_tail[set_index] == way)
+        cache.lru_tail[set_index] = prev;
+    else
+        cache.lru_prev[base + next] = prev;
+    cache.lru_next[base + way] = head;
+    cache.lru_prev[base + head] = way;
+    head = way;
+}
+
+// xorshift64, seeded per cache, for random replacement and BRRIP insertion
+inline uint64_t nextRandom(Cache &cache)
+{
+    uint64_t x = cache.rng_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    cache.rng_state = x;
+    return x;
+}
+
+// True LRU with an O(1) recency list per set
+struct LRUPolicy {
+    static void touch(Cache &cache, uint32_t set_index, uint32_t way) { listMoveToFront(cache, set_index, way); }
+    static void fill(Cache &cache, uint32_t set_index, uint32_t way) { listMoveToFront(cache, set_index, way); }
+    static uint32_t victim(Cache &cache, uint32_t set_index) { return cache.lru_tail[set_index]; }
+};
+
+// True LRU with an age counter per way (the original implementation)
+struct LRUCounterPolicy {
+    static void touch(Cache &cache, uint32_t set_index, uint32_t way)
+    {
+        uint32_t *lru = &cache.lru_counters[set_index * cache.assoc];
+        for (uint32_t i = 0; i < cache.assoc; ++i)
+            lru[i]++;
+        lru[way] = 0;
+    }
+    static void fill(Cache &cache, uint32_t set_index, uint32_t way) { touch(cache, set_index, way); }
+    static uint32_t victim(Cache &cache, uint32_t set_index)
+    {
+        const uint32_t *lru = &cache.lru_counters[set_index * cache.assoc];
+        uint32_t max_lru = 0;
+        uint32_t lru_index = 0;
+        for (uint32_t i = 0; i < cache.assoc; ++i)
+        {
+            if (lru[i] > max_lru)
+            {
+                max_lru = lru[i];
+                lru_index = i;
+            }
+        }
+        return lru_index;
+    }
+};
+
+// Evicts in insertion order; hits do not refresh a line
+struct FIFOPolicy {
+    static void touch(Cache &, uint32_t, uint32_t) {}
+    static void fill(Cache &cache, uint32_t set_index, uint32_t way) { listMoveToFront(cache, set_index, way); }
+    static uint32_t victim(Cache &cache, uint32_t set_index) { return cache.lru_tail[set_index]; }
+};
+
+// Tree pseudo-LRU: one bit per internal node of a binary tree over the ways
+// (rounded up to a power of two), pointing towards the side to evict next
+struct PLRUPolicy {
+    static void touch(Cache &cache, uint32_t set_index, uint32_t way)
+    {
+        uint8_t *bits = &cache.plru_bits[set_index * cache.plru_leaves];
+        uint32_t node = 1, lo = 0, size = cache.plru_leaves;
+        while (size > 1)
+        {
+            size >>= 1;
+            if (way < lo + size)
+            {
+                bits[node] = 1;
+                node = 2 * node;
+            }
+            else
+            {
+                bits[node] = 0;
+                lo += size;
+                node = 2 * node + 1;
+            }
+        }
+    }
+    static void fill(Cache &cache, uint32_t set_index, uint32_t way) { touch(cache, set_index, way); }
+    static uint32_t victim(Cache &cache, uint32_t set_index)
+    {
+        const uint8_t *bits = &cache.plru_bits[set_index * cache.plru_leaves];
+        uint32_t node = 1, lo = 0, size = cache.plru_leaves;
+        while (size > 1)
+        {
+            size >>= 1;
+            // Padding leaves past assoc only ever sit in right subtrees
+            if (bits[node] && lo + size < cache.assoc)
+            {
+                lo += size;
+                node = 2 * node + 1;
+            }
+            else
+            {
+                node = 2 * node;
+            }
+        }
+        return lo;
+    }
+};
+
+// Re-reference interval prediction with 2-bit RRPVs (Jaleel et al.).
+// SRRIP inserts with a long re-reference prediction, BRRIP with a distant
+// one except for one fill in 32.
+static const uint8_t RRPV_MAX = 3;
+
+template <bool Bimodal>
+struct RRIPPolicy {
+    static void touch(Cache &cache, uint32_t set_index, uint32_t way)
+    {
+        cache.rrpv[cache.line(set_index, way)] = 0;
+    }
+    static void fill(Cache &cache, uint32_t set_index, uint32_t way)
+    {
+        uint8_t insert = RRPV_MAX - 1;
+        if (Bimodal && (nextRandom(cache) & 31) != 0)
+            insert = RRPV_MAX;
+        cache.rrpv[cache.line(set_index, way)] = insert;
+    }
+    static uint32_t victim(Cache &cache, uint32_t set_index)
+    {
+        uint8_t *rrpv = &cache.rrpv[set_index * cache.assoc];
+        uint8_t oldest = 0;
+        for (uint32_t i = 0; i < cache.assoc; ++i)
+        {
+            if (rrpv[i] > oldest)
+                oldest = rrpv[i];
+        }
+        // Age the whole set until some line reaches RRPV_MAX, in one step
+        uint8_t age = RRPV_MAX - oldest;
+        uint32_t victim_index = 0;
+        bool found = false;
+        for (uint32_t i = 0; i < cache.assoc; ++i)
+        {
+            rrpv[i] += age;
+            if (!found && rrpv[i] == RRPV_MAX)
+            {
+                victim_index = i;
+                found = true;
+            }
+        }
+        return victim_index;
+    }
+};
+typedef RRIPPolicy<false> SRRIPPolicy;
+typedef RRIPPolicy<true> BRRIPPolicy;
+
+// Uniformly random victim from a seeded generator
+struct RandomPolicy {
+    static void touch(Cache &, uint32_t, uint32_t) {}
+    static void fill(Cache &, uint32_t, uint32_t) {}
+    static uint32_t victim(Cache &cache, uint32_t) { return nextRandom(cache) % cache.assoc; }
+};
+
+// Way to fill on a miss: the first empty way, else the policy's victim
+template <class Policy, class Geometry = DynamicGeometry>
+inline uint32_t findVictim(Cache &cache, uint32_t set_index)
+{
+    const uint8_t *st = &cache.states[Geometry::line(cache, set_index, 0)];
+    const void *invalid = memchr(st, INVALID, Geometry::ways(cache));
+    if (invalid)
+        return static_cast<const uint8_t *>(invalid) - st;
+    return Policy::victim(cache, set_index);
+}
+
+// Expands MACRO(Policy) once per policy, for explicit instantiations
+#define FOR_EACH_REPLACEMENT_POLICY(MACRO) \
+    MACRO(LRUPolicy)                       \
+    MACRO(LRUCounterPolicy)                \
+    MACRO(FIFOPolicy)                      \
+    MACRO(PLRUPolicy)                      \
+    MACRO(SRRIPPolicy)                     \
+    MACRO(BRRIPPolicy)                     \
+    MACRO(RandomPolicy)
+
+#endif
@@ -0,0 +1,473 @@
+#include "sampling.hpp"
+#include "simulator.hpp"
+#include "replacement.hpp"
+#include "geometry.hpp"
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+static const char CHECKPOINT_MAGIC[4] = {'L', '1', 'C', 'K'};
+static const uint32_t CHECKPOINT_VERSION = 3;
+
+bool parseSamplingConfig(const char *arg, SamplingConfig &config)
+{
+    char *end;
+    uint64_t values[3];
+    const char *p = arg;
+    for (int i = 0; i < 3; ++i)
+    {
+        values[i] = strtoull(p, &end, 10);
+        if (end == p || *end != (i < 2 ? ',' : '\0'))
+            return false;
+        p = end + 1;
+    }
+    config.period = values[0];
+    config.warmup = values[1];
+    config.window = values[2];
+    return config.window > 0 && config.warmup + config.window <= config.period;
+}
+
+// Invalidate every other core's copy of a block
+template <class Geometry>
+static void invalidateOthers(Simulator &sim, int core, uint32_t block, uint32_t set_index, uint32_t tag)
+{
+    uint64_t holders = sim.snoop_filter.lookup(block) & ~(1ULL << core);
+    while (holders)
+    {
+        int i = __builtin_ctzll(holders);
+        holders &= holders - 1;
+        Cache &other = sim.caches[i];
+        int way = Geometry::findLine(other, set_index, tag);
+        if (way >= 0)
+            other.states[Geometry::line(other, set_index, way)] = INVALID;
+        sim.snoop_filter.remove(block, i);
+    }
+}
+
+// The state changes a reference makes, as the detailed model makes them,
+// without timing or counters
+template <class Policy, class Geometry>
+static void functionalAccess(Simulator &sim, int core, const TraceRef &ref)
+{
+    Cache &cache = sim.caches[core];
+    bool is_write = ref.op == 'W';
+    uint32_t tag, set_index, block_offset;
+    Geometry::split(cache, ref.addr, tag, set_index, block_offset);
+    uint32_t block = ref.addr >> Geometry::blockOffsetBits(cache);
+    int way = Geometry::findLine(cache, set_index, tag);
+    if (way >= 0)
+    {
+        uint8_t &state = cache.states[Geometry::line(cache, set_index, way)];
+        if (is_write && !isWritable(state))
+            invalidateOthers<Geometry>(sim, core, block, set_index, tag);
+        if (is_write)
+            state = MODIFIED;
+        Policy::touch(cache, set_index, way);
+        return;
+    }
+
+    uint32_t victim_way = findVictim<Policy, Geometry>(cache, set_index);
+    uint32_t victim = Geometry::line(cache, set_index, victim_way);
+    if (cache.states[victim] != INVALID)
+        sim.snoop_filter.remove((cache.tags[victim] << cache.set_index_bits) | set_index, core);
+    bool shared = false, supplied = false;
+    if (is_write)
+    {
+        invalidateOthers<Geometry>(sim, core, block, set_index, tag);
+    }
+    else
+    {
+        // Readers move every other copy to the state the protocol gives it
+        uint64_t holders = sim.snoop_filter.lookup(block) & ~(1ULL << core);
+        while (holders)
+        {
+            int i = __builtin_ctzll(holders);
+            holders &= holders - 1;
+            Cache &other = sim.caches[i];
+            int other_way = Geometry::findLine(other, set_index, tag);
+            if (other_way < 0)
+                continue;
+            uint8_t &state = other.states[Geometry::line(other, set_index, other_way)];
+            supplied |= sim.protocol->read[state].supply;
+            state = sim.protocol->read[state].next;
+            shared = true;
+        }
+    }
+    cache.tags[victim] = tag;
+    cache.states[victim] = sim.protocol->fill(is_write, shared, supplied);
+    cache.prefetched[victim] = 0;
+    sim.snoop_filter.add(block, core);
+    Policy::fill(cache, set_index, victim_way);
+}
+
+template <class Policy, class Geometry>
+void fastForward(Simulator &sim, uint64_t n)
+{
+    std::vector<uint64_t> left(sim.num_cores, n);
+    for (TraceReader &trace : sim.traces)
+        trace.resume();
+    bool any = true;
+    while (any)
+    {
+        any = false;
+        for (int core = 0; core < sim.num_cores; ++core)
+        {
+            TraceReader &trace = sim.traces[core];
+            if (left[core] == 0 || trace.done())
+                continue;
+            any = true;
+            left[core]--;
+            functionalAccess<Policy, Geometry>(sim, core, trace.current());
+            trace.advance();
+            sim.sampling.references++;
+            sim.sampling.functional_references++;
+        }
+    }
+}
+
+#define INSTANTIATE_FAST_FORWARD_FOR(Policy, Geometry) template void fastForward<Policy, Geometry>(Simulator &, uint64_t);
+#define INSTANTIATE_FAST_FORWARD(Policy) FOR_EACH_GEOMETRY(INSTANTIATE_FAST_FORWARD_FOR, Policy)
+FOR_EACH_REPLACEMENT_POLICY(INSTANTIATE_FAST_FORWARD)
+
+SampleWindow sampleCounters(const Simulator &sim)
+{
+    SampleWindow w;
+    for (const Cache &cache : sim.caches)
+    {
+        w.references += cache.read_count + cache.write_count;
+        w.misses += cache.miss_count;
+        w.writebacks += cache.writeback_count;
+    }
+    w.cycles = sim.current_cycle;
+    w.bus_transactions = sim.bus_transactions;
+    w.invalidations = sim.global_stats.invalidations;
+    w.bus_data_traffic = sim.global_stats.bus_data_traffic;
+    return w;
+}
+
+// Checkpoint file: a header identifying the configuration, the cycle, the
+// samples so far and the global counters, then per core its trace position,
+// stall state, line and replacement arrays and counters. The snoop filter
+// is rebuilt from the lines.
+
+template <class T>
+static void put(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <class T>
+static bool get(std::istream &in, T &value)
+{
+    return (bool)in.read(reinterpret_cast<char *>(&value), sizeof(value));
+}
+
+template <class T>
+static void putVector(std::ostream &out, const std::vector<T> &v)
+{
+    put(out, (uint64_t)v.size());
+    out.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+}
+
+// The sizes follow from the configuration, so they must already match
+template <class T>
+static bool getVector(std::istream &in, std::vector<T> &v)
+{
+    uint64_t size;
+    if (!get(in, size) || size != v.size())
+        return false;
+    return (bool)in.read(reinterpret_cast<char *>(v.data()), v.size() * sizeof(T));
+}
+
+// Per-core counters the report prints. They cover the slices before the
+// sample point, so the report of a resumed run covers the whole run.
+static uint64_t Cache::*const CORE_COUNTERS[] = {
+    &Cache::read_count, &Cache::write_count, &Cache::miss_count, &Cache::eviction_count, &Cache::dirty_eviction_count,
+    &Cache::writeback_count, &Cache::idle_cycles, &Cache::invalidation_count, &Cache::hit_cycles, &Cache::memory_cycles,
+    &Cache::data_traffic, &Cache::bus_grants, &Cache::bus_wait_cycles, &Cache::mshr_merges, &Cache::mshr_full_cycles,
+    &Cache::mshr_dependency_cycles,
+};
+static uint64_t Prefetcher::*const PREFETCH_COUNTERS[] = {
+    &Prefetcher::issued, &Prefetcher::useful, &Prefetcher::late, &Prefetcher::polluting,
+    &Prefetcher::unused, &Prefetcher::redundant, &Prefetcher::dropped, &Prefetcher::bytes,
+};
+
+// The prefetcher's tables and counters
+static void putPrefetcher(std::ostream &out, const Prefetcher &prefetcher)
+{
+    putVector(out, prefetcher.strides);
+    putVector(out, prefetcher.streams);
+    put(out, prefetcher.stream_clock);
+    putVector(out, prefetcher.evicted_by_prefetch);
+    putVector(out, prefetcher.inflight);
+    for (uint64_t Prefetcher::*counter : PREFETCH_COUNTERS)
+        put(out, prefetcher.*counter);
+}
+
+static bool getPrefetcher(std::istream &in, Prefetcher &prefetcher)
+{
+    uint64_t inflight;
+    if (!getVector(in, prefetcher.strides) || !getVector(in, prefetcher.streams) || !get(in, prefetcher.stream_clock) ||
+        !getVector(in, prefetcher.evicted_by_prefetch) || !get(in, inflight))
+        return false;
+    prefetcher.inflight.resize(inflight);
+    if (!in.read(reinterpret_cast<char *>(prefetcher.inflight.data()), inflight * sizeof(prefetcher.inflight[0])))
+        return false;
+    for (uint64_t Prefetcher::*counter : PREFETCH_COUNTERS)
+    {
+        if (!get(in, prefetcher.*counter))
+            return false;
+    }
+    return true;
+}
+
+static void putCounters(std::ostream &out, const Simulator &sim, int core)
+{
+    const Cache &cache = sim.caches[core];
+    for (uint64_t Cache::*counter : CORE_COUNTERS)
+        put(out, cache.*counter);
+    putVector(out, cache.bus_wait_histogram);
+    putVector(out, cache.mshr_occupancy);
+    put(out, (uint8_t)!sim.prefetchers.empty());
+    if (!sim.prefetchers.empty())
+        putPrefetcher(out, sim.prefetchers[core]);
+}
+
+static bool getCounters(std::istream &in, Simulator &sim, int core)
+{
+    Cache &cache = sim.caches[core];
+    for (uint64_t Cache::*counter : CORE_COUNTERS)
+    {
+        if (!get(in, cache.*counter))
+            return false;
+    }
+    // The occupancy histogram has --mshrs + 1 entries, and the resumed run
+    // may use another number of MSHRs
+    uint64_t size;
+    if (!getVector(in, cache.bus_wait_histogram) || !get(in, size))
+        return false;
+    std::vector<uint64_t> occupancy(size);
+    if (!in.read(reinterpret_cast<char *>(occupancy.data()), size * sizeof(uint64_t)))
+        return false;
+    if (occupancy.size() > cache.mshr_occupancy.size())
+        cache.mshr_occupancy.resize(occupancy.size());
+    for (size_t n = 0; n < occupancy.size(); ++n)
+        cache.mshr_occupancy[n] = occupancy[n];
+    // A run resumed without a prefetcher reads the saved one and drops it
+    uint8_t prefetching;
+    if (!get(in, prefetching))
+        return false;
+    if (!prefetching)
+        return true;
+    Prefetcher dropped;
+    Prefetcher &prefetcher = sim.prefetchers.empty() ? dropped : sim.prefetchers[core];
+    if (sim.prefetchers.empty())
+        initPrefetcher(dropped, cache.tags.size());
+    return getPrefetcher(in, prefetcher);
+}
+
+static void putGlobalCounters(std::ostream &out, const Simulator &sim)
+{
+    put(out, sim.global_stats);
+    put(out, sim.bus_transactions);
+    put(out, sim.snoop_filter.lookups);
+    put(out, sim.snoop_filter.probes);
+    put(out, sim.peak_memory_inflight);
+    put(out, sim.hierarchy.memory_reads);
+    put(out, sim.hierarchy.memory_writes);
+    put(out, sim.hierarchy.memory_cycles);
+}
+
+static bool getGlobalCounters(std::istream &in, Simulator &sim)
+{
+    return get(in, sim.global_stats) && get(in, sim.bus_transactions) && get(in, sim.snoop_filter.lookups) &&
+           get(in, sim.snoop_filter.probes) && get(in, sim.peak_memory_inflight) && get(in, sim.hierarchy.memory_reads) &&
+           get(in, sim.hierarchy.memory_writes) && get(in, sim.hierarchy.memory_cycles);
+}
+
+static void putConfig(std::ostream &out, const Simulator &sim)
+{
+    put(out, (uint32_t)sim.num_cores);
+    put(out, (uint32_t)sim.config.set_index_bits);
+    put(out, (uint32_t)sim.config.assoc);
+    put(out, (uint32_t)sim.config.block_bits);
+    put(out, (uint32_t)sim.config.replacement);
+    put(out, (uint32_t)sim.config.protocol);
+}
+
+bool writeCheckpoint(const Simulator &sim, const std::string &filename, std::string &error)
+{
+    std::ofstream out(filename, std::ios::binary);
+    if (!out)
+    {
+        error = "Cannot write checkpoint " + filename;
+        return false;
+    }
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    put(out, CHECKPOINT_VERSION);
+    putConfig(out, sim);
+    put(out, sim.current_cycle);
+    const SamplingState &state = sim.sampling;
+    put(out, state.sample_point);
+    put(out, state.references);
+    put(out, state.functional_references);
+    putVector(out, state.windows);
+    putGlobalCounters(out, sim);
+    for (int i = 0; i < sim.num_cores; ++i)
+    {
+        const TraceReader &trace = sim.traces[i];
+        const Cache &cache = sim.caches[i];
+        put(out, (uint64_t)(trace.pos - trace.data));
+        put(out, trace.last_addr);
+        put(out, trace.ref);
+        put(out, (uint8_t)trace.eof);
+        put(out, (int32_t)cache.stall_cycles);
+        put(out, (uint8_t)cache.bus_waiting);
+        put(out, cache.bus_wait_start);
+        putVector(out, cache.tags);
+        putVector(out, cache.states);
+        putVector(out, cache.prefetched);
+        putVector(out, cache.lru_counters);
+        putVector(out, cache.lru_prev);
+        putVector(out, cache.lru_next);
+        putVector(out, cache.lru_head);
+        putVector(out, cache.lru_tail);
+        putVector(out, cache.plru_bits);
+        putVector(out, cache.rrpv);
+        put(out, cache.rng_state);
+        putCounters(out, sim, i);
+    }
+    out.flush();
+    if (!out)
+    {
+        error = "Cannot write checkpoint " + filename;
+        return false;
+    }
+    return true;
+}
+
+bool loadCheckpoint(Simulator &sim, const std::string &filename, std::string &error)
+{
+    std::ifstream in(filename, std::ios::binary);
+    if (!in)
+    {
+        error = "Cannot open checkpoint " + filename;
+        return false;
+    }
+    char magic[4];
+    uint32_t version;
+    in.read(magic, sizeof(magic));
+    if (!in || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 || !get(in, version) || version != CHECKPOINT_VERSION)
+    {
+        error = filename + " is not a checkpoint of this version";
+        return false;
+    }
+    std::ostringstream expected;
+    putConfig(expected, sim);
+    std::string saved(expected.str().size(), '\0');
+    if (!in.read(&saved[0], saved.size()) || saved != expected.str())
+    {
+        error = filename + " was written with another number of cores, cache geometry, replacement policy or protocol";
+        return false;
+    }
+
+    error = "Truncated checkpoint " + filename;
+    uint64_t cycle;
+    SamplingState &state = sim.sampling;
+    uint64_t windows;
+    if (!get(in, cycle) || !get(in, state.sample_point) || !get(in, state.references) ||
+        !get(in, state.functional_references) || !get(in, windows))
+        return false;
+    state.windows.resize(windows);
+    if (!in.read(reinterpret_cast<char *>(state.windows.data()), windows * sizeof(SampleWindow)) ||
+        !getGlobalCounters(in, sim))
+        return false;
+    sim.current_cycle = cycle;
+    sim.snoop_filter.sharers.clear();
+    for (int i = 0; i < sim.num_cores; ++i)
+    {
+        TraceReader &trace = sim.traces[i];
+        Cache &cache = sim.caches[i];
+        uint64_t offset;
+        uint8_t eof, bus_waiting;
+        int32_t stall;
+        if (!get(in, offset) || !get(in, trace.last_addr) || !get(in, trace.ref) || !get(in, eof) || !get(in, stall) ||
+            !get(in, bus_waiting) || !get(in, cache.bus_wait_start))
+            return false;
+        if (offset > trace.size)
+        {
+            error = filename + " does not match the trace " + trace.filename;
+            return false;
+        }
+        trace.pos = trace.data + offset;
+        trace.eof = eof;
+        cache.stall_cycles = stall;
+        cache.bus_waiting = bus_waiting;
+        if (!getVector(in, cache.tags) || !getVector(in, cache.states) || !getVector(in, cache.prefetched) ||
+            !getVector(in, cache.lru_counters) || !getVector(in, cache.lru_prev) || !getVector(in, cache.lru_next) ||
+            !getVector(in, cache.lru_head) || !getVector(in, cache.lru_tail) || !getVector(in, cache.plru_bits) ||
+            !getVector(in, cache.rrpv) || !get(in, cache.rng_state) || !getCounters(in, sim, i))
+            return false;
+        for (uint32_t line = 0; line < cache.tags.size(); ++line)
+        {
+            if (cache.states[line] != INVALID)
+                sim.snoop_filter.add((cache.tags[line] << cache.set_index_bits) | (line / cache.assoc), i);
+        }
+    }
+    error.clear();
+    return true;
+}
+
+// Mean of a per-reference rate over the windows, and its 95% confidence half-width
+static void estimateRate(const std::vector<SampleWindow> &windows, uint64_t SampleWindow::*field, double &mean, double &half_width)
+{
+    double sum = 0, sum_squares = 0;
+    size_t n = 0;
+    for (const SampleWindow &w : windows)
+    {
+        if (!w.references)
+            continue;
+        double rate = (double)(w.*field) / w.references;
+        sum += rate;
+        sum_squares += rate * rate;
+        n++;
+    }
+    mean = n ? sum / n : 0.0;
+    double variance = n > 1 ? (sum_squares - n * mean * mean) / (n - 1) : 0.0;
+    half_width = n > 1 && variance > 0 ? 1.96 * std::sqrt(variance / n) : 0.0;
+}
+
+void writeSamplingReport(const Simulator &sim, std::ostream &out)
+{
+    const SamplingConfig &config = sim.config.sampling;
+    const SamplingState &state = sim.sampling;
+    out << "Sampled Simulation:\n";
+    out << "Sample Period/Warmup/Window (references per core): " << config.period << "/" << config.warmup << "/"
+        << config.window << "\n";
+    out << "Measured Windows: " << state.windows.size() << "\n";
+    out << "References: " << state.references << " (" << state.references - state.functional_references << " detailed, "
+        << state.functional_references << " fast-forwarded)\n";
+    double mean, half_width;
+    estimateRate(state.windows, &SampleWindow::misses, mean, half_width);
+    out << "Estimated Miss Rate: " << std::fixed << std::setprecision(2) << mean * 100 << "% +/- " << half_width * 100 << "%\n";
+    struct Estimate {
+        const char *name;
+        uint64_t SampleWindow::*field;
+    };
+    const Estimate estimates[] = {
+        {"Estimated Total Cycles", &SampleWindow::cycles},
+        {"Estimated Bus Transactions", &SampleWindow::bus_transactions},
+        {"Estimated Invalidations", &SampleWindow::invalidations},
+        {"Estimated Writebacks", &SampleWindow::writebacks},
+        {"Estimated Bus Traffic (Bytes)", &SampleWindow::bus_data_traffic},
+    };
+    for (const Estimate &e : estimates)
+    {
+        estimateRate(state.windows, e.field, mean, half_width);
+        out << e.name << ": " << std::setprecision(0) << mean * state.references << " +/- " << half_width * state.references << "\n";
+    }
+    out << "(95% confidence intervals, from the spread of the measured windows)\n";
+}
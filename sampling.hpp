@@ -0,0 +1,74 @@
+#ifndef SAMPLING_HPP
+#define SAMPLING_HPP
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+// Sampled simulation (--sample, snooping bus without shared levels). Each
+// core's trace is cut into periods of `period` references. Every period
+// starts with `warmup` references simulated in detail to warm the timing
+// state, then `window` references simulated and measured in detail; the rest
+// of the period is fast-forwarded functionally, updating only tags,
+// replacement and MESI state, with no bus timing or counters. Detailed
+// slices end once every core has issued its share and the bus has drained,
+// so each sample point starts from an idle bus. The whole-run statistics are
+// extrapolated from the per-reference rates of the measured windows, with
+// 95% confidence intervals from their spread.
+//
+// At every sample point the state the next slice starts from (cache lines
+// and replacement state, prefetcher tables, trace positions, cycle, every
+// counter and the samples so far) can be written as a checkpoint. A run
+// resumed from one continues exactly as the original run would, so its
+// report is the original's; with other bus, MSHR or prefetch settings, the
+// slices from the checkpoint on use them. The cache geometry, replacement
+// policy and coherence protocol must match.
+
+struct SamplingConfig {
+    uint64_t period = 0; // references per core per sample period; 0 simulates everything in detail
+    uint64_t warmup = 0;
+    uint64_t window = 0;
+    std::string checkpoint_dir; // write <dir>/sample_<k>.ckpt at every sample point
+};
+
+// Counter deltas of one measured window, summed over the cores
+struct SampleWindow {
+    uint64_t references = 0;
+    uint64_t misses = 0;
+    uint64_t cycles = 0;
+    uint64_t bus_transactions = 0;
+    uint64_t invalidations = 0;
+    uint64_t writebacks = 0;
+    uint64_t bus_data_traffic = 0;
+};
+
+struct SamplingState {
+    uint64_t sample_point = 0;          // index of the next sample point
+    uint64_t references = 0;            // references consumed, detailed and functional
+    uint64_t functional_references = 0;
+    std::vector<SampleWindow> windows;
+};
+
+struct Simulator;
+
+// Parse a --sample argument "<period>,<warmup>,<window>"
+bool parseSamplingConfig(const char *arg, SamplingConfig &config);
+
+// Consume up to n more references of every core functionally, round-robin
+// across the cores, keeping the caches and snoop filter coherent
+template <class Policy, class Geometry>
+void fastForward(Simulator &sim, uint64_t n);
+
+// Sum of the counters a measured window is the difference of
+SampleWindow sampleCounters(const Simulator &sim);
+
+// Write or load the state at the current sample point; false on I/O or
+// configuration mismatch, with the reason in error
+bool writeCheckpoint(const Simulator &sim, const std::string &filename, std::string &error);
+bool loadCheckpoint(Simulator &sim, const std::string &filename, std::string &error);
+
+// The "Sampled Simulation" report section
+void writeSamplingReport(const Simulator &sim, std::ostream &out);
+
+#endif
@@ -0,0 +1,161 @@
+#include "sharing.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+static const uint32_t INITIAL_BITS = 10;
+
+BlockMap::BlockMap() : table(1u << INITIAL_BITS), shift(64 - INITIAL_BITS)
+{
+}
+
+void BlockMap::grow()
+{
+    std::vector<BlockRecord> old(table.size() * 2);
+    old.swap(table);
+    shift--;
+    for (const BlockRecord &r : old)
+    {
+        if (!r.used)
+            continue;
+        size_t i = home(r.block);
+        while (table[i].used)
+            i = (i + 1) & (table.size() - 1);
+        table[i] = r;
+    }
+}
+
+BlockRecord &BlockMap::operator[](uint32_t block)
+{
+    size_t i = home(block);
+    while (table[i].used)
+    {
+        if (table[i].block == block)
+            return table[i];
+        i = (i + 1) & (table.size() - 1);
+    }
+    if ((count + 1) * 10 > table.size() * 7)
+    {
+        grow();
+        return (*this)[block];
+    }
+    count++;
+    BlockRecord &r = table[i];
+    r.used = true;
+    r.block = block;
+    memset(r.chunks, CHUNK_UNTOUCHED, sizeof(r.chunks));
+    return r;
+}
+
+void initSharingProfile(SharingProfile &profile, uint32_t top, uint32_t block_bits)
+{
+    profile.top = top;
+    profile.block_bits = block_bits;
+    // At most SHARING_CHUNKS words per block, and none smaller than 4 bytes
+    profile.chunk_bits = std::max<int>(2, (int)block_bits - 4);
+}
+
+void recordSharingAccess(SharingProfile &profile, int core, uint32_t addr, bool is_write, bool miss, bool supplied)
+{
+    BlockRecord &r = profile.blocks[addr >> profile.block_bits];
+    if (miss)
+        r.misses++;
+    else
+        r.upgrades++;
+    if (supplied)
+        r.transfers++;
+    if (is_write)
+    {
+        if (r.last_writer >= 0 && r.last_writer != core)
+            r.handoffs++;
+        r.last_writer = core;
+        r.writers |= 1ULL << core;
+    }
+    else
+    {
+        r.readers |= 1ULL << core;
+    }
+    uint32_t chunk = (addr & ((1u << profile.block_bits) - 1)) >> profile.chunk_bits;
+    uint8_t &owner = r.chunks[chunk];
+    if (owner == CHUNK_UNTOUCHED)
+        owner = core;
+    else if (owner != core)
+        owner = CHUNK_SHARED;
+}
+
+void recordSharingInvalidation(SharingProfile &profile, uint32_t block)
+{
+    profile.blocks[block].invalidations++;
+}
+
+static const char *sharingPattern(const BlockRecord &r)
+{
+    if (!r.writers)
+        return "read-shared";
+    bool word_shared = false;
+    for (uint8_t owner : r.chunks)
+        word_shared |= owner == CHUNK_SHARED;
+    if (!word_shared)
+        return "false sharing";
+    if (__builtin_popcountll(r.writers) == 1)
+        return "producer-consumer";
+    if ((r.readers & ~r.writers) == 0)
+        return "migratory";
+    return "write-shared";
+}
+
+static void writeCores(std::ostream &out, uint64_t cores)
+{
+    if (!cores)
+        out << "none";
+    for (bool first = true; cores; first = false)
+    {
+        out << (first ? "" : ",") << __builtin_ctzll(cores);
+        cores &= cores - 1;
+    }
+}
+
+void writeSharingReport(const SharingProfile &profile, std::ostream &out)
+{
+    // Blocks more than one core used, hottest first by coherence events
+    std::vector<const BlockRecord *> shared;
+    for (const BlockRecord &r : profile.blocks.slots())
+    {
+        if (r.used && __builtin_popcountll(r.readers | r.writers) > 1)
+            shared.push_back(&r);
+    }
+    auto hotter = [](const BlockRecord *a, const BlockRecord *b) {
+        uint64_t ea = (uint64_t)a->invalidations + a->transfers, eb = (uint64_t)b->invalidations + b->transfers;
+        return ea != eb ? ea > eb : a->block < b->block;
+    };
+    size_t shown = std::min<size_t>(profile.top, shared.size());
+    std::partial_sort(shared.begin(), shared.begin() + shown, shared.end(), hotter);
+
+    uint32_t chunk_bytes = 1u << profile.chunk_bits;
+    uint32_t chunks = std::min<uint32_t>(SHARING_CHUNKS, std::max<uint32_t>(1, (1u << profile.block_bits) / chunk_bytes));
+    out << "Sharing Profile (top " << shown << " of " << shared.size() << " blocks used by several cores, "
+        << profile.blocks.size() << " blocks seen):\n";
+    for (size_t i = 0; i < shown; ++i)
+    {
+        const BlockRecord &r = *shared[i];
+        out << "Block 0x" << std::hex << std::setw(8) << std::setfill('0') << (r.block << profile.block_bits) << std::dec
+            << std::setfill(' ') << ": " << sharingPattern(r) << "\n";
+        out << "  Invalidations: " << r.invalidations << ", Cache-to-cache Transfers: " << r.transfers
+            << ", Misses: " << r.misses << ", Upgrades: " << r.upgrades << ", Writer Handoffs: " << r.handoffs << "\n";
+        out << "  Writers: ";
+        writeCores(out, r.writers);
+        out << ", Readers: ";
+        writeCores(out, r.readers);
+        out << "\n  Cores by " << chunk_bytes << "-byte word:";
+        for (uint32_t c = 0; c < chunks; ++c)
+        {
+            if (r.chunks[c] == CHUNK_UNTOUCHED)
+                out << " -";
+            else if (r.chunks[c] == CHUNK_SHARED)
+                out << " *";
+            else
+                out << " " << (int)r.chunks[c];
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef SHARING_HPP
+#define SHARING_HPP
+
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+// Per-block sharing profile (--sharing-profile N, snooping bus only). Every
+// demand miss and upgrade on the bus updates a small record of its block:
+// misses, upgrades, copies other cores' writes invalidated, misses another
+// cache supplied, which cores read and wrote it, how often the writing core
+// changed, and which core touched each word of the block. The report lists
+// the N blocks with the most invalidations and cache-to-cache transfers,
+// each with its likely sharing pattern:
+//   false sharing      several cores, but each word only ever touched by one
+//   producer-consumer  one core writes, others only read
+//   migratory          several cores write, and every core that reads it
+//                      also writes it, so it moves from core to core
+//   write-shared       several writers and read-only sharers of the same words
+//   read-shared        nobody writes it
+// Hits never reach the bus, so words touched only by hits are not seen;
+// lines that ping-pong miss on nearly every access, so their records are
+// close to complete.
+
+static const int SHARING_CHUNKS = 16;     // words tracked per block, 4 bytes or more each
+static const uint8_t CHUNK_UNTOUCHED = 0xff;
+static const uint8_t CHUNK_SHARED = 0xfe; // touched by more than one core
+
+struct BlockRecord {
+    uint32_t block;
+    bool used = false;
+    int8_t last_writer = -1;
+    uint8_t chunks[SHARING_CHUNKS]; // per word: the one core that touched it, or CHUNK_*
+    uint32_t misses = 0;
+    uint32_t upgrades = 0;
+    uint32_t invalidations = 0;
+    uint32_t transfers = 0;         // misses another cache supplied
+    uint32_t handoffs = 0;          // writes by another core than the previous writer
+    uint64_t readers = 0;           // core bitmaps
+    uint64_t writers = 0;
+};
+
+// Block address -> record, open addressing with linear probing. Records
+// live in one array, so a lookup touches one or two cache lines and the
+// table grows by rehashing at 70% load.
+class BlockMap {
+public:
+    BlockMap();
+    // The block's record, created empty on first use
+    BlockRecord &operator[](uint32_t block);
+    size_t size() const { return count; }
+    const std::vector<BlockRecord> &slots() const { return table; }
+
+private:
+    std::vector<BlockRecord> table; // capacity is a power of two
+    size_t count = 0;
+    uint32_t shift;
+
+    size_t home(uint32_t block) const { return (block * 0x9E3779B97F4A7C15ULL) >> shift; }
+    void grow();
+};
+
+struct SharingProfile {
+    BlockMap blocks;
+    uint32_t top;          // blocks to report
+    uint32_t block_bits;
+    uint32_t chunk_bits;   // log2 of the bytes per tracked word
+};
+
+void initSharingProfile(SharingProfile &profile, uint32_t top, uint32_t block_bits);
+// A demand miss (or an upgrade, when miss is false) of core at addr
+void recordSharingAccess(SharingProfile &profile, int core, uint32_t addr, bool is_write, bool miss, bool supplied);
+// A copy of the block invalidated by another core's write
+void recordSharingInvalidation(SharingProfile &profile, uint32_t block);
+// The "Sharing Profile" report section
+void writeSharingReport(const SharingProfile &profile, std::ostream &out);
+
+#endif
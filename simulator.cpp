@@ -0,0 +1,1033 @@
+#include "simulator.hpp"
+#include "replacement.hpp"
+#include "parallel.hpp"
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <memory>
+
+// Split bus: whether another memory fill may start this cycle
+static bool memorySlotFree(Simulator &sim)
+{
+    while (!sim.memory_inflight.empty() && sim.memory_inflight.top() <= sim.current_cycle)
+        sim.memory_inflight.pop();
+    return sim.memory_inflight.size() < sim.config.bus.max_outstanding;
+}
+
+// Split bus: whether fills are still on their way from memory
+static bool fillsInFlight(Simulator &sim)
+{
+    memorySlotFree(sim);
+    return !sim.memory_inflight.empty();
+}
+
+// Non-blocking mode: the MSHR tracking a block, or -1
+static int findMSHR(const Cache &cache, uint32_t block)
+{
+    for (size_t i = 0; i < cache.mshrs.size(); ++i)
+    {
+        if (cache.mshrs[i].block == block)
+            return i;
+    }
+    return -1;
+}
+
+// Free the MSHRs whose data has arrived by `now`
+static void retireMSHRs(Cache &cache, uint64_t now)
+{
+    for (size_t i = 0; i < cache.mshrs.size();)
+    {
+        if (cache.mshrs[i].granted && cache.mshrs[i].ready <= now)
+        {
+            cache.mshrs[i] = cache.mshrs.back();
+            cache.mshrs.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+// Why a non-blocking core cannot issue its next reference this cycle
+enum MSHRStall { MSHR_NO_STALL, MSHR_STALL_FULL, MSHR_STALL_DEPENDENCY };
+
+template <class Geometry>
+static MSHRStall mshrStall(Simulator &sim, int core)
+{
+    Cache &cache = sim.caches[core];
+    const TraceRef &ref = sim.traces[core].current();
+    bool is_write = ref.op == 'W';
+    int pending = findMSHR(cache, ref.addr >> Geometry::blockOffsetBits(cache));
+    if (pending >= 0)
+    {
+        // Merges into the outstanding miss, unless a write has to wait for a read fill
+        return is_write && !cache.mshrs[pending].is_write ? MSHR_STALL_DEPENDENCY : MSHR_NO_STALL;
+    }
+    if (cache.mshrs.size() < sim.config.mshrs)
+        return MSHR_NO_STALL;
+    uint32_t tag, set_index, block_offset;
+    Geometry::split(cache, ref.addr, tag, set_index, block_offset);
+    int way = Geometry::findLine(cache, set_index, tag);
+    if (way >= 0 && !(is_write && !isWritable(cache.state(set_index, way))))
+        return MSHR_NO_STALL;
+    return MSHR_STALL_FULL;
+}
+
+static void recordBusWait(Cache &cache, uint64_t wait)
+{
+    int bucket = 0;
+    while (bucket < BUS_WAIT_BUCKETS - 1 && (1ULL << bucket) <= wait)
+        bucket++;
+    cache.bus_wait_histogram[bucket]++;
+    cache.bus_grants++;
+    cache.bus_wait_cycles += wait;
+}
+
+// Number of upcoming cycles in which nothing but stall/idle/bus countdowns happen.
+// Returns 0 if the next cycle has real work (a hit, a bus request or a grant).
+template <class Geometry>
+static uint32_t quietCycles(Simulator &sim)
+{
+    bool split = sim.config.bus.mode == BUS_SPLIT;
+    if (!sim.bus_queue.empty() && (!split || (sim.bus_busy_cycles == 0 && memorySlotFree(sim))))
+        return 0;
+    if (!sim.prefetch_queue.empty() && sim.bus_busy_cycles == 0 && (!split || memorySlotFree(sim)))
+        return 0;
+
+    // The bus frees up after bus_busy_cycles; a core waiting on it acts then
+    uint32_t quiet = sim.bus_busy_cycles > 0 ? sim.bus_busy_cycles : UINT32_MAX;
+    if (split && fillsInFlight(sim))
+    {
+        // A completing fill frees a memory slot for queued requests
+        uint64_t slot = sim.memory_inflight.top() - sim.current_cycle;
+        if (slot < quiet)
+            quiet = slot;
+    }
+    for (int core = 0; core < sim.num_cores; ++core)
+    {
+        // Stop at every MSHR retirement, it can unblock the core and changes occupancy
+        for (const MSHR &m : sim.caches[core].mshrs)
+        {
+            if (m.granted && m.ready - sim.current_cycle < quiet)
+                quiet = m.ready - sim.current_cycle;
+        }
+        if (sim.traces[core].done())
+            continue;
+        int stall = sim.caches[core].stall_cycles;
+        if (stall > 0)
+        {
+            if ((uint32_t)stall < quiet)
+                quiet = stall;
+            continue;
+        }
+        // Cores queued on the split bus idle until the grant
+        if (stall < 0 && split)
+            continue;
+        if (sim.config.mshrs)
+        {
+            if (mshrStall<Geometry>(sim, core) == MSHR_NO_STALL)
+                return 0;
+            continue;
+        }
+        if (stall < 0 || sim.bus_busy_cycles == 0 || split)
+            return 0;
+
+        // A ready core stays idle only if its next reference needs the bus
+        char op = sim.traces[core].current().op;
+        uint32_t addr = sim.traces[core].current().addr;
+        uint32_t tag, set_index, block_offset;
+        Geometry::split(sim.caches[core], addr, tag, set_index, block_offset);
+        int way = Geometry::findLine(sim.caches[core], set_index, tag);
+        if (way >= 0 && !(op == 'W' && !isWritable(sim.caches[core].state(set_index, way))))
+            return 0;
+    }
+    if (quiet == UINT32_MAX)
+        return 0;
+    // Rows of a time series fall on their exact cycles
+    return quiet < cyclesToNextSample(sim) ? quiet : cyclesToNextSample(sim);
+}
+
+// Fast-forward over quiet cycles, applying the same stall/idle accounting
+// the per-cycle loop would have done
+template <class Geometry>
+static void skipQuietCycles(Simulator &sim)
+{
+    uint32_t skip = quietCycles<Geometry>(sim);
+    if (skip == 0)
+        return;
+    PROFILE_COUNT(COUNT_SKIPS);
+    PROFILE_ADD(COUNT_SKIPPED_CYCLES, skip);
+    for (int core = 0; core < sim.num_cores; ++core)
+    {
+        Cache &cache = sim.caches[core];
+        if (sim.config.mshrs)
+            cache.mshr_occupancy[cache.mshrs.size()] += skip;
+        if (sim.traces[core].done())
+            continue;
+        if (cache.stall_cycles > 0)
+        {
+            cache.stall_cycles -= skip;
+            continue;
+        }
+        cache.idle_cycles += skip;
+        // A ready blocking core here is waiting for the busy bus, from the first skipped cycle
+        if (!sim.config.mshrs && cache.stall_cycles == 0 && !cache.bus_waiting)
+        {
+            cache.bus_waiting = true;
+            cache.bus_wait_start = sim.current_cycle;
+        }
+        if (sim.config.mshrs && cache.stall_cycles == 0)
+        {
+            MSHRStall stall = mshrStall<Geometry>(sim, core);
+            if (stall == MSHR_STALL_FULL)
+                cache.mshr_full_cycles += skip;
+            else if (stall == MSHR_STALL_DEPENDENCY)
+                cache.mshr_dependency_cycles += skip;
+        }
+    }
+    if (sim.bus_busy_cycles > 0)
+    {
+        sim.bus_busy_cycles -= skip;
+        sim.global_stats.bus_busy_cycles += skip;
+    }
+    sim.current_cycle += skip;
+}
+
+// Parallel engine: run the cycles from now in which every ready core only
+// hits its own L1 and the bus cannot grant anything, with the same stall,
+// idle and bus accounting as the serial loop (see parallel.hpp). Returns the
+// cycles run, 0 if the current cycle needs the serial loop.
+template <class Policy, class Geometry>
+static uint32_t runParallelWindow(Simulator &sim, HitRunner<Policy, Geometry> &runner, std::vector<int> &hitting,
+                                  std::vector<uint32_t> &hits)
+{
+    bool split = sim.config.bus.mode == BUS_SPLIT;
+    if (!sim.bus_queue.empty() && (!split || (sim.bus_busy_cycles == 0 && memorySlotFree(sim))))
+        return 0;
+
+    uint32_t limit = sim.bus_busy_cycles > 0 && (uint32_t)sim.bus_busy_cycles < PARALLEL_WINDOW ? sim.bus_busy_cycles : PARALLEL_WINDOW;
+    if (cyclesToNextSample(sim) < limit)
+        limit = cyclesToNextSample(sim);
+    if (split && fillsInFlight(sim) && sim.memory_inflight.top() - sim.current_cycle < limit)
+        limit = sim.memory_inflight.top() - sim.current_cycle;
+    hitting.clear();
+    for (int core = 0; core < sim.num_cores; ++core)
+    {
+        if (sim.traces[core].done())
+            continue;
+        int stall = sim.caches[core].stall_cycles;
+        if (stall > 0)
+        {
+            if ((uint32_t)stall < limit)
+                limit = stall;
+            continue;
+        }
+        // Cores queued on the split bus idle until the grant
+        if (stall < 0 && split)
+            continue;
+        if (stall < 0)
+            return 0;
+        const TraceRef &ref = sim.traces[core].current();
+        uint32_t tag, set_index, block_offset;
+        Geometry::split(sim.caches[core], ref.addr, tag, set_index, block_offset);
+        int way = Geometry::findLine(sim.caches[core], set_index, tag);
+        if (way >= 0 && !(ref.op == 'W' && !isWritable(sim.caches[core].state(set_index, way))))
+        {
+            hitting.push_back(core);
+            continue;
+        }
+        // A core needing the bus acts now, unless it waits for the busy blocking bus
+        if (sim.bus_busy_cycles == 0 || split)
+            return 0;
+    }
+    if (hitting.empty())
+        return 0;
+
+    PROFILE_SCOPE(PHASE_PARALLEL);
+    runner.scan(hitting, limit, hits);
+    uint32_t window = limit;
+    for (uint32_t n : hits)
+    {
+        if (n < window)
+            window = n;
+    }
+    if (window == 0)
+        return 0;
+    runner.apply(hitting, window);
+    PROFILE_COUNT(COUNT_PARALLEL_WINDOWS);
+    PROFILE_ADD(COUNT_PARALLEL_CYCLES, window);
+
+    // Everyone else, as skipQuietCycles
+    size_t next_hitting = 0;
+    for (int core = 0; core < sim.num_cores; ++core)
+    {
+        if (next_hitting < hitting.size() && hitting[next_hitting] == core)
+        {
+            next_hitting++;
+            continue;
+        }
+        Cache &cache = sim.caches[core];
+        if (sim.traces[core].done())
+            continue;
+        if (cache.stall_cycles > 0)
+        {
+            cache.stall_cycles -= window;
+            continue;
+        }
+        cache.idle_cycles += window;
+        if (cache.stall_cycles == 0 && !cache.bus_waiting)
+        {
+            cache.bus_waiting = true;
+            cache.bus_wait_start = sim.current_cycle;
+        }
+    }
+    if (sim.bus_busy_cycles > 0)
+    {
+        sim.bus_busy_cycles -= window;
+        sim.global_stats.bus_busy_cycles += window;
+    }
+    sim.current_cycle += window;
+    return window;
+}
+
+// Main simulation loop, instantiated per replacement policy and geometry
+template <class Policy, class Geometry>
+static void simulate(Simulator &sim)
+{
+    bool all_done;
+    bool non_blocking = sim.config.mshrs > 0;
+
+    // Parallel windows need every core-to-core interaction to go through a grant
+    std::unique_ptr<HitRunner<Policy, Geometry>> runner;
+    std::vector<int> hitting;
+    std::vector<uint32_t> hits;
+    uint32_t serial_iterations = 0;
+    if (sim.config.threads > 1 && !non_blocking && sim.config.prefetch.kind == PREFETCH_NONE)
+        runner.reset(new HitRunner<Policy, Geometry>(sim, sim.config.threads));
+
+    while (true)
+    {
+        PROFILE_TICK(sim);
+        if (runner && serial_iterations == 0)
+        {
+            uint32_t window = runParallelWindow(sim, *runner, hitting, hits);
+            if (window < PARALLEL_MIN_WINDOW && window > 0)
+                serial_iterations = PARALLEL_BACKOFF;
+            if (window && sim.timeseries)
+                updateTimeSeries(sim);
+            if (window)
+                continue;
+        }
+        else if (serial_iterations)
+        {
+            serial_iterations--;
+        }
+
+        if (non_blocking)
+        {
+            for (int core = 0; core < sim.num_cores; ++core)
+                retireMSHRs(sim.caches[core], sim.current_cycle);
+        }
+
+        // Process cores
+        all_done = true;
+        for (int core = 0; core < sim.num_cores; ++core)
+        {
+            if (!sim.traces[core].done())
+            {
+                all_done = false;
+                // Check if the core is ready to process a new reference
+                if (sim.caches[core].stall_cycles == 0)
+                {
+                    // Always try to process the reference - if it's a hit, it will complete
+                    // If it's a miss and the bus is busy, it will be stalled
+                    char op = sim.traces[core].current().op;
+                    uint32_t addr = sim.traces[core].current().addr;
+
+                    // Parse the address to check if it's a hit
+                    uint32_t tag, set_index, block_offset;
+                    Geometry::split(sim.caches[core], addr, tag, set_index, block_offset);
+
+                    // Check if it's a hit
+                    int hit_index = Geometry::findLine(sim.caches[core], set_index, tag);
+                    bool hit = hit_index >= 0;
+
+                    // If it's a hit, process it regardless of bus state
+                    // If it's a write hit to a shared copy, we need the bus, so check bus state
+                    bool is_write = (op == 'W');
+                    uint32_t block = addr >> Geometry::blockOffsetBits(sim.caches[core]);
+                    MSHRStall mshr_stall = non_blocking ? mshrStall<Geometry>(sim, core) : MSHR_NO_STALL;
+                    int pending = non_blocking ? findMSHR(sim.caches[core], block) : -1;
+                    if (mshr_stall != MSHR_NO_STALL)
+                    {
+                        // Non-blocking cache out of MSHRs, or a write behind a read fill
+                        sim.caches[core].idle_cycles++;
+                        if (mshr_stall == MSHR_STALL_FULL)
+                            sim.caches[core].mshr_full_cycles++;
+                        else
+                            sim.caches[core].mshr_dependency_cycles++;
+                    }
+                    else if (pending >= 0)
+                    {
+                        // Merge into the outstanding miss and keep going
+                        is_write ? sim.caches[core].write_count++ : sim.caches[core].read_count++;
+                        sim.caches[core].mshrs[pending].merged++;
+                        sim.caches[core].mshr_merges++;
+                        sim.traces[core].advance();
+                        sim.caches[core].hit_cycles++;
+                    }
+                    else if (hit && !(is_write && !isWritable(sim.caches[core].state(set_index, hit_index))))
+                    {
+                        // Process the hit (not a write to a shared copy)
+                        retireHit<Policy>(sim.caches[core], sim.traces[core], is_write, set_index, hit_index);
+                        // A late prefetch: wait for the rest of its fill
+                        uint32_t line = Geometry::line(sim.caches[core], set_index, hit_index);
+                        if (sim.caches[core].prefetched[line])
+                        {
+                            uint32_t wait = prefetchOnUse(sim, core, line, addr);
+                            sim.caches[core].stall_cycles = wait;
+                            sim.caches[core].memory_cycles += wait;
+                        }
+                    }
+                    // If it's a miss or a write hit to a shared copy, we need the bus
+                    // (the split bus and non-blocking caches queue the request even while busy)
+                    else if (sim.config.bus.mode == BUS_SPLIT || non_blocking || (sim.bus_busy_cycles == 0 && sim.bus_queue.empty()))
+                    {
+                        // For a miss or write hit to a shared copy, execution will take additional cycles
+                        // These cycles will be accounted for in processReference and handleMiss
+                        if (non_blocking)
+                        {
+                            MSHR mshr;
+                            mshr.block = block;
+                            mshr.is_write = is_write;
+                            sim.caches[core].mshrs.push_back(mshr);
+                        }
+                        processReference<Policy, Geometry>(sim, core, op, addr);
+                        sim.traces[core].advance();
+                    }
+                    else
+                    {
+                        // Bus is busy but core has a pending request that needs the bus
+                        // Count as idle cycle and stall the core until bus is available
+                        sim.caches[core].idle_cycles++;
+                        if (!sim.caches[core].bus_waiting)
+                        {
+                            sim.caches[core].bus_waiting = true;
+                            sim.caches[core].bus_wait_start = sim.current_cycle;
+                        }
+                        // caches[core].stall_cycles = 1; // Stall for at least one cycle, will be reset when bus becomes available
+                    }
+                }
+                else if (sim.caches[core].stall_cycles < 0)
+                {
+                    // Queued on the split bus, waiting for the grant
+                    sim.caches[core].idle_cycles++;
+                }
+                else if (sim.caches[core].stall_cycles > 0)
+                { // the core is in undergoing a bus command.
+                    sim.caches[core].stall_cycles--;
+                    // Count this as an idle cycle since the core is waiting for a request to complete
+                    // caches[core].idle_cycles++;
+                }
+            }
+        }
+        bool split = sim.config.bus.mode == BUS_SPLIT;
+        if (!sim.bus_queue.empty() || sim.bus_busy_cycles > 0 || (split && fillsInFlight(sim)))
+        {
+            all_done = false;
+        }
+        for (int core = 0; core < sim.num_cores && non_blocking; ++core)
+        {
+            if (!sim.caches[core].mshrs.empty())
+                all_done = false;
+        }
+
+        if (all_done)
+            break;
+
+        // Process bus transactions first; prefetches only get an otherwise idle bus
+        BusRequest req;
+        bool granted = false, prefetch = false;
+        if (sim.bus_busy_cycles == 0 && (!split || memorySlotFree(sim)))
+        {
+            if (!sim.bus_queue.empty())
+            {
+                req = sim.bus_queue.grant();
+                granted = true;
+            }
+            else if (!sim.prefetch_queue.empty())
+            {
+                granted = prefetch = nextPrefetch(sim, req);
+            }
+        }
+        if (granted)
+        {
+            sim.bus_transactions++;
+            PROFILE_COUNT(COUNT_BUS_GRANTS);
+            uint64_t traffic_before = sim.global_stats.bus_data_traffic;
+            if (!prefetch)
+                recordBusWait(sim.caches[req.core], sim.current_cycle - req.posted);
+            // Special handling: if it is a writeback eviction request
+
+            uint32_t tag, set_index, block_offset;
+            Geometry::split(sim.caches[req.core], req.addr, tag, set_index, block_offset);
+            bool hit = Geometry::findLine(sim.caches[req.core], set_index, tag) >= 0;
+
+            bool shared = hit ? true : false; // if a hit, it must be a write hit at a shared copy to be in the bus.
+            bool supplied = false;
+            snoopBus<Geometry>(sim, req.core, req.addr, req.is_write, shared, supplied);
+            // An upgrade leaves the writer the only copy
+            if (hit && req.is_write)
+                sim.caches[req.core].setState(set_index, Geometry::findLine(sim.caches[req.core], set_index, tag), MODIFIED);
+
+            // A non-blocking core keeps running; the latency goes to its MSHR instead.
+            // Prefetches never stall the core.
+            int running_stall = sim.caches[req.core].stall_cycles;
+            sim.caches[req.core].stall_cycles = 0;
+
+            uint32_t fill_latency = 0;
+            if (!hit)
+                fill_latency = handleMiss<Policy, Geometry>(sim, req.core, req.addr, req.is_write, set_index, tag, prefetch);
+
+            // bus_busy_cycles = supplied ? 2 * (caches[0].block_size/4) : 100;
+            uint32_t occupancy;
+            if (hit)
+            { // If a write hit at a shared copy then takes one cycle to invalidate (1 for hit)
+                occupancy = 1;
+            }
+            else if (supplied)
+            { // if miss which gets data from cache, then 2N
+                // Cache-to-cache transfer
+                sim.caches[req.core].stall_cycles += 2 * (Geometry::blockSize(sim.caches[0]) / 4) - 1; //-1 because in this very cycle, it will start getting executed, so this cycle counts too
+                occupancy = 2 * (Geometry::blockSize(sim.caches[0]) / 4);                             // For bus, we will subtract 1 before the end of this cycle (below), so we don't need to do -1 here
+            }
+            else
+            { // miss with memory transfer, then 100 (less on a shared-level hit)
+                // Memory access
+                sim.caches[req.core].stall_cycles += fill_latency - 1;
+                occupancy = fill_latency;
+                if (split)
+                {
+                    // Only the address phase holds the split bus; the fill takes a memory slot
+                    occupancy = 1;
+                    sim.memory_inflight.push(sim.current_cycle + fill_latency);
+                    if (sim.memory_inflight.size() > sim.peak_memory_inflight)
+                        sim.peak_memory_inflight = sim.memory_inflight.size();
+                }
+            }
+            // The split bus also keeps the data phases of writebacks this transaction caused
+            sim.bus_busy_cycles = split ? sim.bus_busy_cycles + occupancy : occupancy;
+
+            if (prefetch)
+            {
+                Cache &cache = sim.caches[req.core];
+                prefetchIssued(sim, req, sim.current_cycle + cache.stall_cycles + 1, sim.global_stats.bus_data_traffic - traffic_before);
+                cache.stall_cycles = running_stall;
+            }
+            else if (non_blocking)
+            {
+                Cache &cache = sim.caches[req.core];
+                int pending = findMSHR(cache, req.addr >> Geometry::blockOffsetBits(cache));
+                cache.mshrs[pending].granted = true;
+                cache.mshrs[pending].ready = sim.current_cycle + cache.stall_cycles + 1;
+                cache.stall_cycles = running_stall;
+            }
+
+            sim.current_initiator = req.core;
+        }
+
+        for (int core = 0; core < sim.num_cores && non_blocking; ++core)
+            sim.caches[core].mshr_occupancy[sim.caches[core].mshrs.size()]++;
+
+        // Advance cycles
+        sim.current_cycle++;
+        if (sim.bus_busy_cycles > 0)
+        {
+            sim.bus_busy_cycles--;
+            sim.global_stats.bus_busy_cycles++;
+        }
+        if (sim.timeseries)
+            updateTimeSeries(sim);
+
+        if (sim.config.event_driven)
+        {
+            skipQuietCycles<Geometry>(sim);
+            if (sim.timeseries)
+                updateTimeSeries(sim);
+        }
+    }
+
+    sim.global_stats.total_cycles = sim.current_cycle;
+    if (sim.timeseries)
+        finishTimeSeries(sim);
+}
+
+// Sampled simulation (sampling.hpp): at each sample point, detailed warmup
+// and measured window slices, then a functional fast-forward to the next
+template <class Policy, class Geometry>
+static void simulateSampled(Simulator &sim)
+{
+    const SamplingConfig &config = sim.config.sampling;
+    SamplingState &state = sim.sampling;
+    while (true)
+    {
+        bool left = false;
+        for (const TraceReader &trace : sim.traces)
+            left |= !trace.done();
+        if (!left)
+            break;
+
+        // Proposals of the last slice's prefetchers do not carry over, so a
+        // sample point is fully described by its checkpoint
+        sim.prefetch_queue.clear();
+        if (!config.checkpoint_dir.empty())
+        {
+            std::string error;
+            if (!writeCheckpoint(sim, config.checkpoint_dir + "/sample_" + std::to_string(state.sample_point) + ".ckpt", error))
+            {
+                std::cerr << error << "\n";
+                exit(1);
+            }
+        }
+
+        SampleWindow start = sampleCounters(sim);
+        for (TraceReader &trace : sim.traces)
+            trace.holdAfter(config.warmup);
+        simulate<Policy, Geometry>(sim);
+        SampleWindow warm = sampleCounters(sim);
+        for (TraceReader &trace : sim.traces)
+            trace.holdAfter(config.window);
+        simulate<Policy, Geometry>(sim);
+        SampleWindow end = sampleCounters(sim);
+
+        SampleWindow w;
+        w.references = end.references - warm.references;
+        w.misses = end.misses - warm.misses;
+        w.cycles = end.cycles - warm.cycles;
+        w.bus_transactions = end.bus_transactions - warm.bus_transactions;
+        w.invalidations = end.invalidations - warm.invalidations;
+        w.writebacks = end.writebacks - warm.writebacks;
+        w.bus_data_traffic = end.bus_data_traffic - warm.bus_data_traffic;
+        if (w.references)
+            state.windows.push_back(w);
+        state.references += end.references - start.references;
+
+        fastForward<Policy, Geometry>(sim, config.period - config.warmup - config.window);
+        state.sample_point++;
+    }
+}
+
+// Detailed or sampled simulation of the snooping model
+template <class Policy, class Geometry>
+static void simulateSnoop(Simulator &sim)
+{
+    if (sim.config.sampling.period)
+        simulateSampled<Policy, Geometry>(sim);
+    else
+        simulate<Policy, Geometry>(sim);
+}
+
+// Run the selected coherence model with one replacement policy. The snooping
+// model uses a prebuilt fixed-geometry instance when one matches the config.
+template <class Policy>
+static void runModel(Simulator &sim)
+{
+    PROFILE_SCOPE(PHASE_SIMULATE);
+    if (sim.config.coherence_mode == COHERENCE_DIRECTORY)
+    {
+        simulateDirectory<Policy>(sim);
+        return;
+    }
+    if (!sim.config.fixed_geometries)
+    {
+        simulateSnoop<Policy, DynamicGeometry>(sim);
+        return;
+    }
+    const SimulatorConfig &c = sim.config;
+#define SIMULATE_IF_MATCHES(Policy, Geometry)                      \
+    if (Geometry::matches(c.set_index_bits, c.assoc, c.block_bits)) \
+    {                                                              \
+        simulateSnoop<Policy, Geometry>(sim);                      \
+        return;                                                    \
+    }
+    FOR_EACH_GEOMETRY(SIMULATE_IF_MATCHES, Policy)
+#undef SIMULATE_IF_MATCHES
+}
+
+// Lines still dirty at the end are written back to memory
+static void writeBackModifiedLines(Simulator &sim)
+{
+    PROFILE_SCOPE(PHASE_WRITEBACK);
+    for (int core = 0; core < sim.num_cores; core++)
+    {
+        Cache &cache = sim.caches[core];
+        for (size_t i = 0; i < cache.states.size(); i++)
+        {
+            if (isDirty(cache.states[i]))
+            {
+                uint32_t set_index = i / cache.assoc;
+                uint32_t latency = writeBackBlock(sim, ((cache.tags[i] << cache.set_index_bits) | set_index) << cache.block_offset_bits);
+                cache.memory_cycles += latency;
+                sim.global_stats.total_cycles += latency;
+            }
+        }
+    }
+}
+
+Simulator::Simulator(const SimulatorConfig &config)
+    : config(config), num_cores(config.num_cores), caches(config.num_cores), traces(config.num_cores),
+      protocol(&protocolTable(config.protocol))
+{
+    for (int i = 0; i < num_cores; ++i)
+    {
+        initCache(caches[i], config.set_index_bits, config.assoc, config.block_bits, config.replacement, config.seed + i);
+    }
+    bus_queue.policy = config.bus.arbitration;
+    for (int i = 0; i < num_cores; ++i)
+        caches[i].mshr_occupancy.assign(config.mshrs + 1, 0);
+    if (config.prefetch.kind != PREFETCH_NONE && config.coherence_mode == COHERENCE_SNOOP)
+    {
+        prefetchers.resize(num_cores);
+        for (int i = 0; i < num_cores; ++i)
+            initPrefetcher(prefetchers[i], caches[i].tags.size());
+    }
+    if (config.sharing_top && config.coherence_mode == COHERENCE_SNOOP)
+    {
+        sharing.reset(new SharingProfile);
+        initSharingProfile(*sharing, config.sharing_top, config.block_bits);
+    }
+    initHierarchy(hierarchy, config.levels, config.block_bits,
+                  config.coherence_mode == COHERENCE_DIRECTORY ? config.directory_config.memory_latency : 100);
+}
+
+bool Simulator::openTrace(int core, const std::string &filename)
+{
+    return traces[core].open(filename);
+}
+
+bool Simulator::openTraces(const std::string &prefix, std::string *failed_file)
+{
+    for (int i = 0; i < num_cores; ++i)
+    {
+        // Prefer a packed binary trace written by trace2bin when there is one
+        // and the text trace has not changed since. References are decoded on
+        // demand while simulating.
+        std::string filename = binaryTraceFileName(prefix, i);
+        std::string text_filename = traceFileName(prefix, i);
+        struct stat binary_st, text_st;
+        if (access(filename.c_str(), R_OK) != 0)
+            filename = text_filename;
+        else if (stat(filename.c_str(), &binary_st) == 0 && stat(text_filename.c_str(), &text_st) == 0 &&
+                 binary_st.st_mtime < text_st.st_mtime)
+        {
+            std::cerr << "Warning: " << text_filename << " is newer than " << filename << ", using the text trace\n";
+            filename = text_filename;
+        }
+        if (!openTrace(i, filename))
+        {
+            if (failed_file)
+                *failed_file = filename;
+            return false;
+        }
+    }
+    // Parsing then runs ahead of the simulation, on as many threads as traces
+    for (int i = 0; i < num_cores && config.pipeline; ++i)
+        traces[i].startPipeline();
+    return true;
+}
+
+void Simulator::shareTraces(const std::vector<TraceReader> &source)
+{
+    for (int i = 0; i < num_cores; ++i)
+    {
+        traces[i].share(source[i]);
+    }
+}
+
+void Simulator::run()
+{
+    Profile *outer_profile = profile_current;
+    profile_current = &profile;
+    switch (config.replacement)
+    {
+    case REPL_LRU:
+        runModel<LRUPolicy>(*this);
+        break;
+    case REPL_LRU_COUNTER:
+        runModel<LRUCounterPolicy>(*this);
+        break;
+    case REPL_FIFO:
+        runModel<FIFOPolicy>(*this);
+        break;
+    case REPL_PLRU:
+        runModel<PLRUPolicy>(*this);
+        break;
+    case REPL_SRRIP:
+        runModel<SRRIPPolicy>(*this);
+        break;
+    case REPL_BRRIP:
+        runModel<BRRIPPolicy>(*this);
+        break;
+    case REPL_RANDOM:
+        runModel<RandomPolicy>(*this);
+        break;
+    }
+
+    writeBackModifiedLines(*this);
+    profile_current = outer_profile;
+}
+
+void Simulator::profileTick()
+{
+    if (++profile.counts[COUNT_LOOP_ITERATIONS] % 4096)
+        return;
+    uint64_t references = 0;
+    for (const Cache &cache : caches)
+        references += cache.read_count + cache.write_count;
+    profile.sampleRate(references);
+}
+
+void Simulator::writeReport(std::ostream &out, const std::string &trace_name) const
+{
+    // Print simulation parameters
+    out << "Simulation Parameters:\n";
+    out << "Trace Prefix: " << trace_name << "\n";
+    out << "Set Index Bits: " << config.set_index_bits << "\n";
+    out << "Associativity: " << config.assoc << "\n";
+    out << "Block Bits: " << config.block_bits << "\n";
+    out << "Block Size (Bytes): " << (1 << config.block_bits) << "\n";
+    out << "Number of Sets: " << (1 << config.set_index_bits) << "\n";
+    out << "Number of Cores: " << num_cores << "\n";
+    out << "Cache Size (KB per core): " << std::fixed << std::setprecision(2) << ((1 << config.set_index_bits) * config.assoc * (1 << config.block_bits)) / 1024.0 << "\n";
+    out << coherenceProtocolName(config.protocol) << " Protocol: Enabled\n";
+    out << "Write Policy: Write-back, Write-allocate\n";
+    out << "Replacement Policy: " << replacementPolicyName(config.replacement) << "\n";
+    if (config.coherence_mode == COHERENCE_DIRECTORY)
+        out << "Coherence: Directory (hop " << config.directory_config.hop_latency << ", lookup " << config.directory_config.lookup_latency
+                << ", memory " << config.directory_config.memory_latency << " cycles)\n";
+    else if (config.bus.mode == BUS_SPLIT)
+        out << "Bus: Split-transaction snooping bus (" << config.bus.max_outstanding << " outstanding fills, "
+            << busArbitrationName(config.bus.arbitration) << " arbitration)\n";
+    else
+        out << "Bus: Central snooping bus\n";
+    if (config.coherence_mode == COHERENCE_SNOOP && config.mshrs)
+        out << "L1 Caches: Non-blocking, " << config.mshrs << " MSHRs per core\n";
+    if (!prefetchers.empty())
+        out << "Prefetcher: " << prefetcherName(config.prefetch.kind) << ", degree " << config.prefetch.degree << "\n";
+    if (config.sampling.period)
+        out << "Sampled: statistics below cover the detailed slices only, see Sampled Simulation\n";
+    for (size_t i = 0; i < hierarchy.levels.size(); ++i)
+    {
+        const LevelConfig &level = hierarchy.levels[i].config;
+        out << "L" << i + 2 << " Cache (shared): " << level.size_kb << " KB, " << level.assoc << "-way, " << level.latency
+            << " cycles, " << inclusionPolicyName(level.inclusion) << "\n";
+    }
+    out << "\n";
+
+    // Print per-core statistics
+    for (int i = 0; i < num_cores; ++i)
+    {
+        out << "Core " << i << " Statistics:\n";
+        out << "Total Instructions: " << (caches[i].read_count + caches[i].write_count) << "\n";
+        out << "Total Reads: " << caches[i].read_count << "\n";
+        out << "Total Writes: " << caches[i].write_count << "\n";
+        out << "Total Execution Cycles: " << (caches[i].hit_cycles + caches[i].memory_cycles) << "\n";
+        out << "Idle Cycles: " << caches[i].idle_cycles << "\n";
+        out << "Cache Misses: " << caches[i].miss_count << "\n";
+        out << "Cache Miss Rate: " << std::fixed << std::setprecision(5) << (double)caches[i].miss_count / (caches[i].read_count + caches[i].write_count) * 100 << "%\n";
+        out << "Cache Evictions: " << caches[i].eviction_count << "\n";
+        out << "Writebacks: " << caches[i].writeback_count << "\n";
+        out << "Bus Invalidations: " << caches[i].invalidation_count << "\n";
+        out << "Data Traffic (Bytes): " << caches[i].data_traffic << "\n";
+        if (config.coherence_mode == COHERENCE_SNOOP)
+        {
+            out << "Bus Grants: " << caches[i].bus_grants << "\n";
+            out << "Average Bus Wait (cycles): " << std::fixed << std::setprecision(3)
+                << (caches[i].bus_grants ? (double)caches[i].bus_wait_cycles / caches[i].bus_grants : 0.0) << "\n";
+            out << "Bus Wait Histogram (cycles):";
+            for (int b = 0; b < BUS_WAIT_BUCKETS; ++b)
+            {
+                if (!caches[i].bus_wait_histogram[b])
+                    continue;
+                if (b <= 1)
+                    out << " " << b;
+                else
+                    out << " " << (1ULL << (b - 1)) << "-" << (1ULL << b) - 1;
+                out << ":" << caches[i].bus_wait_histogram[b];
+            }
+            out << "\n";
+        }
+        if (config.coherence_mode == COHERENCE_SNOOP && config.mshrs)
+        {
+            // Memory-level parallelism: average outstanding misses over cycles with at least one
+            uint64_t cycles = 0, busy_cycles = 0, occupied = 0;
+            for (size_t n = 0; n < caches[i].mshr_occupancy.size(); ++n)
+            {
+                cycles += caches[i].mshr_occupancy[n];
+                if (n)
+                    busy_cycles += caches[i].mshr_occupancy[n];
+                occupied += n * caches[i].mshr_occupancy[n];
+            }
+            out << "MSHR Merges: " << caches[i].mshr_merges << "\n";
+            out << "Cycles Stalled on Full MSHRs: " << caches[i].mshr_full_cycles << "\n";
+            out << "Cycles Stalled on Dependencies: " << caches[i].mshr_dependency_cycles << "\n";
+            out << "Average MSHR Occupancy: " << std::fixed << std::setprecision(3) << (cycles ? (double)occupied / cycles : 0.0) << "\n";
+            out << "Memory-Level Parallelism: " << std::fixed << std::setprecision(3)
+                << (busy_cycles ? (double)occupied / busy_cycles : 0.0) << "\n";
+            out << "MSHR Occupancy Histogram (cycles):";
+            for (size_t n = 0; n < caches[i].mshr_occupancy.size(); ++n)
+                out << " " << n << ":" << caches[i].mshr_occupancy[n];
+            out << "\n";
+        }
+        if (!prefetchers.empty())
+        {
+            // Accuracy: share of issued prefetches that were used. Coverage: share
+            // of the misses the core would have taken that prefetches removed.
+            const Prefetcher &p = prefetchers[i];
+            out << "Prefetches Issued: " << p.issued << "\n";
+            out << "Useful Prefetches: " << p.useful << "\n";
+            out << "Late Prefetches: " << p.late << "\n";
+            out << "Polluting Prefetches: " << p.polluting << "\n";
+            out << "Unused Prefetches Evicted: " << p.unused << "\n";
+            out << "Prefetches Dropped (redundant/queue full): " << p.redundant << "/" << p.dropped << "\n";
+            out << "Prefetch Accuracy: " << std::fixed << std::setprecision(5)
+                << (p.issued ? (double)p.useful / p.issued * 100 : 0.0) << "%\n";
+            out << "Prefetch Coverage: " << std::fixed << std::setprecision(5)
+                << (p.useful + caches[i].miss_count ? (double)p.useful / (p.useful + caches[i].miss_count) * 100 : 0.0) << "%\n";
+            out << "Prefetch Bus Traffic (Bytes): " << p.bytes << "\n";
+        }
+        out << "\n";
+    }
+
+    // Print replacement summary across all cores
+    uint64_t total_misses = 0, total_evictions = 0, total_dirty_evictions = 0;
+    for (int i = 0; i < num_cores; ++i)
+    {
+        total_misses += caches[i].miss_count;
+        total_evictions += caches[i].eviction_count;
+        total_dirty_evictions += caches[i].dirty_eviction_count;
+    }
+    out << "Replacement Summary (" << replacementPolicyName(config.replacement) << "):\n";
+    out << "Total Cache Misses: " << total_misses << "\n";
+    out << "Total Evictions: " << total_evictions << "\n";
+    out << "Dirty Evictions: " << total_dirty_evictions << "\n\n";
+
+    // Print overall bus summary
+    out << "Overall Bus Summary:\n";
+    out << "Total Bus Transactions: " << bus_transactions << "\n";
+    out << "Total Bus Traffic (Bytes): " << global_stats.bus_data_traffic << "\n";
+    if (config.coherence_mode == COHERENCE_SNOOP)
+    {
+        out << "Snoop Filter Lookups: " << snoop_filter.lookups << "\n";
+        out << "Snoop Probes: " << snoop_filter.probes << "\n";
+        out << "Writeback Cycles: " << global_stats.writeback_cycles << "\n";
+        if (config.bus.mode == BUS_SPLIT)
+            out << "Peak Outstanding Memory Fills: " << peak_memory_inflight << "\n";
+    }
+    out << "Maximum Execution Time (cycles): " << global_stats.total_cycles << "\n";
+
+    if (config.coherence_mode == COHERENCE_DIRECTORY)
+    {
+        uint64_t writes = 0, max_fanout = 0;
+        for (size_t n = 0; n < directory_stats.fanout.size(); ++n)
+        {
+            writes += directory_stats.fanout[n];
+            if (directory_stats.fanout[n])
+                max_fanout = n;
+        }
+        out << "\nDirectory Summary:\n";
+        out << "Directory Transactions: " << directory_stats.transactions << "\n";
+        out << "Directory Lookups: " << directory_stats.lookups << "\n";
+        out << "Forwarded Requests: " << directory_stats.forwarded << "\n";
+        out << "Invalidations Sent: " << directory_stats.invalidations_sent << "\n";
+        out << "Average Invalidation Fan-out: " << std::fixed << std::setprecision(3)
+                << (writes ? (double)directory_stats.invalidations_sent / writes : 0.0) << "\n";
+        out << "Maximum Invalidation Fan-out: " << max_fanout << "\n";
+        out << "Invalidation Fan-out Histogram:";
+        for (size_t n = 0; n < directory_stats.fanout.size(); ++n)
+        {
+            if (directory_stats.fanout[n])
+                out << " " << n << ":" << directory_stats.fanout[n];
+        }
+        out << "\n";
+        out << "Point-to-point Messages: " << directory_stats.messages << "\n";
+        out << "Cycles Queued on Busy Blocks: " << directory_stats.queued_cycles << "\n";
+    }
+
+    if (!hierarchy.levels.empty())
+    {
+        uint64_t l1_hit_cycles = 0;
+        for (int i = 0; i < num_cores; ++i)
+            l1_hit_cycles += caches[i].hit_cycles;
+        out << "\nMemory Hierarchy Summary:\n";
+        for (size_t i = 0; i < hierarchy.levels.size(); ++i)
+        {
+            const SharedLevel &level = hierarchy.levels[i];
+            std::string name = "L" + std::to_string(i + 2);
+            out << name << " Reads: " << level.reads << "\n";
+            out << name << " Hits: " << level.read_hits << "\n";
+            out << name << " Hit Rate: " << std::fixed << std::setprecision(5)
+                << (level.reads ? (double)level.read_hits / level.reads * 100 : 0.0) << "%\n";
+            out << name << " Writes: " << level.writes << "\n";
+            out << name << " Evictions: " << level.evictions << "\n";
+            out << name << " Writebacks: " << level.writebacks << "\n";
+            out << name << " Back-invalidations: " << level.back_invalidations << "\n";
+        }
+        out << "Memory Reads: " << hierarchy.memory_reads << "\n";
+        out << "Memory Writes: " << hierarchy.memory_writes << "\n";
+        out << "Latency Breakdown (cycles): L1 hits " << l1_hit_cycles;
+        for (size_t i = 0; i < hierarchy.levels.size(); ++i)
+            out << ", L" << i + 2 << " " << hierarchy.levels[i].cycles;
+        out << ", memory " << hierarchy.memory_cycles << "\n";
+    }
+
+    if (sharing)
+    {
+        out << "\n";
+        writeSharingReport(*sharing, out);
+    }
+
+    if (config.sampling.period)
+    {
+        out << "\n";
+        writeSamplingReport(*this, out);
+    }
+}
+
+void Simulator::writeProfile(std::ostream &out) const
+{
+    // Phase times exclude the phases nested inside them, so they add up
+    out << std::fixed << std::setprecision(6);
+    out << "{\n  \"phases\": {\n";
+    for (int p = 0; p < PHASE_COUNT; ++p)
+    {
+        out << "    \"" << profilePhaseName((ProfilePhase)p) << "\": {\"seconds\": " << profile.seconds(profile.ticks[p])
+            << ", \"calls\": " << profile.calls[p] << "}" << (p + 1 < PHASE_COUNT ? "," : "") << "\n";
+    }
+    out << "  },\n  \"counters\": {\n";
+    for (int c = 0; c < COUNTER_COUNT; ++c)
+        out << "    \"" << profileCounterName((ProfileCounter)c) << "\": " << profile.counts[c] << ",\n";
+    out << "    \"snoop_filter_lookups\": " << snoop_filter.lookups << ",\n";
+    out << "    \"snoop_probes\": " << snoop_filter.probes << "\n";
+    out << "  },\n  \"caches\": [\n";
+    size_t count = caches.size() + hierarchy.levels.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        bool l1 = i < caches.size();
+        const Cache &cache = l1 ? caches[i] : hierarchy.levels[i - caches.size()].cache;
+        out << "    {\"cache\": \"" << (l1 ? "L1 core " + std::to_string(i) : "L" + std::to_string(i - caches.size() + 2))
+            << "\", \"set_lookups\": " << cache.profile_lookups << ", \"replacement_updates\": " << cache.profile_replacement_updates
+            << "}" << (i + 1 < count ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"host_rate\": [\n";
+    for (size_t i = 0; i < profile.rates.size(); ++i)
+    {
+        const ProfileRateSample &sample = profile.rates[i];
+        out << "    {\"seconds\": " << sample.seconds << ", \"references\": " << sample.references
+            << ", \"references_per_second\": " << std::setprecision(0) << sample.rate << std::setprecision(6) << "}"
+            << (i + 1 < profile.rates.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
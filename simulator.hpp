@@ -0,0 +1,120 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+#include <vector>
+#include <queue>
+#include <deque>
+#include <unordered_map>
+#include <string>
+#include <ostream>
+#include <functional>
+#include <memory>
+#include "cache.hpp"
+#include "bus.hpp"
+#include "trace.hpp"
+#include "directory.hpp"
+#include "coherence.hpp"
+#include "hierarchy.hpp"
+#include "prefetch.hpp"
+#include "profile.hpp"
+#include "timeseries.hpp"
+#include "sampling.hpp"
+#include "sharing.hpp"
+
+// Everything that selects what a simulation models
+struct SimulatorConfig {
+    int num_cores = 4;
+    int set_index_bits = 0;
+    int assoc = 1;
+    int block_bits = 0;
+    ReplacementPolicy replacement = REPL_LRU;
+    uint64_t seed = 1;        // per-core generators are seeded seed + core
+    bool event_driven = true; // skip over cycles in which no core or bus changes state
+    bool fixed_geometries = true; // use a compile-time specialized simulator when one matches (geometry.hpp)
+    int threads = 1;          // host threads simulating the cores (parallel.hpp); same results
+    bool pipeline = false;    // openTraces() parses every trace on a thread of its own (trace.hpp)
+    CoherenceMode coherence_mode = COHERENCE_SNOOP;
+    CoherenceProtocol protocol = PROTOCOL_MESI; // snooping bus protocol (coherence.hpp)
+    DirectoryConfig directory_config;
+    BusConfig bus;
+    uint32_t mshrs = 0;       // non-blocking L1s with this many MSHRs per core; 0 blocks on every miss
+    PrefetchConfig prefetch;  // L1 hardware prefetcher (snooping bus only)
+    TimeSeriesConfig timeseries; // counter time series, once openTimeSeries names its file
+    SamplingConfig sampling;  // sampled simulation (sampling.hpp); period 0 simulates every reference in detail
+    uint32_t sharing_top = 0; // per-block sharing profile (sharing.hpp): hot blocks to report, 0 disables it
+    std::vector<LevelConfig> levels; // shared L2, L3 behind the L1s (hierarchy.hpp)
+};
+
+// One complete simulation: the caches, the interconnect, the trace cursors
+// and every counter. Instances share nothing, so several can run at once on
+// separate threads. Typical use:
+//   Simulator sim(config);
+//   sim.openTraces(prefix);
+//   sim.run();
+//   sim.writeReport(out, prefix);   // or read caches / global_stats directly
+struct Simulator {
+    SimulatorConfig config;
+    int num_cores;
+    std::vector<Cache> caches;
+    Stats global_stats;
+    std::vector<TraceReader> traces;
+    uint64_t current_cycle = 0;
+
+    // Snooping bus
+    BusArbiter bus_queue;
+    int bus_busy_cycles = 0;
+    int current_initiator = -1;
+    uint64_t bus_transactions = 0; // Counter for bus (or directory) transactions
+    SnoopFilter snoop_filter;
+    const ProtocolTable *protocol; // transitions of config.protocol
+    // Split bus: completion cycles of the memory fills in flight
+    std::priority_queue<uint64_t, std::vector<uint64_t>, std::greater<uint64_t>> memory_inflight;
+    uint64_t peak_memory_inflight = 0;
+    // Prefetching: per-core prefetchers and the proposals waiting for an idle bus
+    std::vector<Prefetcher> prefetchers;
+    std::deque<BusRequest> prefetch_queue;
+
+    // Directory mode
+    std::unordered_map<uint32_t, DirectoryEntry> directory;
+    DirectoryStats directory_stats;
+
+    // Shared levels and memory below the L1s
+    MemoryHierarchy hierarchy;
+
+    // Sampled simulation progress and measured windows
+    SamplingState sampling;
+
+    // Per-block sharing records, when profiling (sharing.hpp)
+    std::unique_ptr<SharingProfile> sharing;
+
+    // Counter time series, when opened (timeseries.hpp)
+    std::unique_ptr<TimeSeries> timeseries;
+
+    // Instrumentation of the simulator itself, filled by make PROFILE=1 builds
+    Profile profile;
+
+    explicit Simulator(const SimulatorConfig &config);
+    Simulator(const Simulator &) = delete;
+    Simulator &operator=(const Simulator &) = delete;
+
+    // Open the trace for one core; false if the file cannot be opened
+    bool openTrace(int core, const std::string &filename);
+    // Open <prefix>_procN for every core, preferring packed .btrace files,
+    // and start their parser threads if config.pipeline is set.
+    // On failure returns false with the offending file in failed_file.
+    bool openTraces(const std::string &prefix, std::string *failed_file = nullptr);
+    // Read the same, already opened traces as another simulation, without copying them
+    void shareTraces(const std::vector<TraceReader> &source);
+
+    // Simulate until every trace is consumed, then write back dirty lines
+    void run();
+
+    // The statistics report L1simulate writes to its -o file
+    void writeReport(std::ostream &out, const std::string &trace_name) const;
+    // The profile as JSON, for instrumented builds (profile.hpp)
+    void writeProfile(std::ostream &out) const;
+    // Count a loop iteration and, every 4096, log the references done so far
+    void profileTick();
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "stackdist.hpp"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+
+const uint32_t StackDistanceSet::COLD;
+
+void StackDistanceSet::add(uint32_t slot, int32_t delta)
+{
+    for (; slot <= tree.size(); slot += slot & -slot)
+        tree[slot - 1] += delta;
+}
+
+uint32_t StackDistanceSet::prefix(uint32_t slot) const
+{
+    uint32_t count = 0;
+    for (; slot > 0; slot -= slot & -slot)
+        count += tree[slot - 1];
+    return count;
+}
+
+void StackDistanceSet::compact(std::vector<uint32_t> &last_use)
+{
+    // Renumber the live blocks 1..live in order of use, leaving as many free slots
+    uint32_t capacity = std::max<uint32_t>(16, 2 * live);
+    std::vector<uint32_t> moved;
+    moved.reserve(capacity);
+    for (uint32_t i = 0; i < used; ++i)
+    {
+        if (slots[i] == COLD)
+            continue;
+        moved.push_back(slots[i]);
+        last_use[slots[i]] = moved.size();
+    }
+    moved.resize(capacity, COLD);
+    slots.swap(moved);
+    used = live;
+
+    // Linear-time build of a tree with one mark in each of the first `used` slots
+    tree.assign(capacity, 0);
+    for (uint32_t i = 1; i <= capacity; ++i)
+    {
+        if (i <= used)
+            tree[i - 1]++;
+        uint32_t parent = i + (i & -i);
+        if (parent <= capacity)
+            tree[parent - 1] += tree[i - 1];
+    }
+}
+
+uint32_t StackDistanceSet::access(uint32_t block, std::vector<uint32_t> &last_use)
+{
+    uint32_t distance = COLD;
+    uint32_t previous = last_use[block];
+    if (previous)
+    {
+        // The marks after the block's own are the distinct blocks used since
+        distance = live - prefix(previous);
+        add(previous, -1);
+        slots[previous - 1] = COLD;
+        live--;
+    }
+    if (used == tree.size())
+        compact(last_use);
+    used++;
+    add(used, 1);
+    slots[used - 1] = block;
+    last_use[block] = used;
+    live++;
+    return distance;
+}
+
+// Stack distance histograms of one core for one block size, per set count
+struct CoreCurves {
+    uint64_t references = 0;
+    std::vector<uint64_t> cold;                   // per -s value: first uses
+    std::vector<std::vector<uint64_t>> distances; // per -s value: uses at distance d, the last bucket d >= max assoc
+};
+
+static void analyseCore(TraceReader &trace, int block_bits, const std::vector<int> &set_bits, int max_assoc, CoreCurves &curves)
+{
+    // Blocks get dense ids, so each set count indexes its last uses by id
+    std::unordered_map<uint32_t, uint32_t> ids;
+    std::vector<std::vector<StackDistanceSet>> sets(set_bits.size());
+    std::vector<std::vector<uint32_t>> last_use(set_bits.size());
+    curves.cold.assign(set_bits.size(), 0);
+    curves.distances.assign(set_bits.size(), std::vector<uint64_t>(max_assoc + 1, 0));
+    for (size_t i = 0; i < set_bits.size(); ++i)
+        sets[i].resize(1u << set_bits[i]);
+
+    for (; !trace.done(); trace.advance())
+    {
+        uint32_t addr = trace.current().addr;
+        uint32_t block, set_index, block_offset;
+        parseAddress(addr, 0, block_bits, block, set_index, block_offset);
+        auto inserted = ids.insert(std::make_pair(block, (uint32_t)ids.size()));
+        uint32_t id = inserted.first->second;
+        curves.references++;
+        for (size_t i = 0; i < set_bits.size(); ++i)
+        {
+            if (inserted.second)
+                last_use[i].push_back(0);
+            uint32_t tag;
+            parseAddress(addr, set_bits[i], block_bits, tag, set_index, block_offset);
+            uint32_t distance = sets[i][set_index].access(id, last_use[i]);
+            if (distance == StackDistanceSet::COLD)
+                curves.cold[i]++;
+            else
+                curves.distances[i][std::min<uint32_t>(distance, max_assoc)]++;
+        }
+    }
+}
+
+static uint64_t missesAt(const CoreCurves &curves, size_t set_count, int assoc)
+{
+    uint64_t misses = curves.cold[set_count];
+    const std::vector<uint64_t> &d = curves.distances[set_count];
+    for (size_t i = assoc; i < d.size(); ++i)
+        misses += d[i];
+    return misses;
+}
+
+int runStackDistance(const SimulatorConfig &base, const std::vector<TraceReader> &traces,
+                     const std::vector<int> &set_bits, const std::vector<int> &assocs, const std::vector<int> &block_bits,
+                     int jobs, const std::string &outfilename)
+{
+    int cores = base.num_cores;
+    int max_assoc = *std::max_element(assocs.begin(), assocs.end());
+    size_t items = block_bits.size() * cores;
+    if (jobs < 1)
+        jobs = 1;
+    if ((size_t)jobs > items)
+        jobs = items;
+
+    std::cout << "Analysing stack distances of " << cores << " traces for " << set_bits.size() * assocs.size() * block_bits.size()
+              << " configurations on " << jobs << " threads.\n";
+    std::cout.flush();
+
+    // Each thread claims the next (block size, core) pass until none are left
+    std::vector<CoreCurves> curves(items);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < items; i = next++)
+        {
+            TraceReader trace;
+            trace.share(traces[i % cores]);
+            analyseCore(trace, block_bits[i / cores], set_bits, max_assoc, curves[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < jobs; ++t)
+        threads.emplace_back(worker);
+    for (auto &t : threads)
+        t.join();
+
+    std::ofstream outfile(outfilename);
+    outfile << "set_index_bits,assoc,block_bits,cache_kb,core,instructions,misses,miss_rate\n";
+    for (size_t s = 0; s < set_bits.size(); ++s)
+    {
+        for (int e : assocs)
+        {
+            for (size_t b = 0; b < block_bits.size(); ++b)
+            {
+                uint64_t total_refs = 0, total_misses = 0;
+                for (int core = 0; core <= cores; ++core)
+                {
+                    uint64_t refs = total_refs, misses = total_misses;
+                    if (core < cores)
+                    {
+                        const CoreCurves &c = curves[b * cores + core];
+                        refs = c.references;
+                        misses = missesAt(c, s, e);
+                        total_refs += refs;
+                        total_misses += misses;
+                    }
+                    outfile << set_bits[s] << "," << e << "," << block_bits[b] << "," << std::fixed << std::setprecision(2)
+                            << ((1 << set_bits[s]) * e * (1 << block_bits[b])) / 1024.0 << ","
+                            << (core < cores ? std::to_string(core) : "all") << "," << refs << "," << misses << ","
+                            << std::setprecision(5) << (refs ? (double)misses / refs * 100 : 0.0) << "\n";
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef STACKDIST_HPP
+#define STACKDIST_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "simulator.hpp"
+
+// Miss curves from LRU stack distances (--stack-distance). For a fixed
+// number of sets, a reference hits an LRU cache of any associativity A
+// exactly when fewer than A other blocks of its set were used since its
+// previous use (Mattson et al.). One pass over a core's trace therefore
+// gives its misses for every associativity at once; the pass tracks every
+// requested set count side by side, so the whole -s x -E grid comes from a
+// single read of each trace. Every set keeps a Fenwick tree over the times
+// of its blocks' last uses, so counting the distinct blocks since a use
+// takes O(log n). Cores are analysed as isolated LRU caches: there is no
+// coherence, so invalidation misses are not counted. Curves are meant to
+// pick the points worth a full simulation.
+
+// The LRU stack of one cache set. Each block in it has one mark in a Fenwick
+// tree, at the time slot of its last use; the blocks used more recently than
+// a block are the marks after its slot. Slots are compacted when they run out,
+// so memory stays proportional to the blocks the set has seen.
+class StackDistanceSet {
+public:
+    static const uint32_t COLD = UINT32_MAX;
+
+    // Record a use of block (a dense id); last_use holds every block's slot
+    // in this set, 0 for never. Returns the block's stack distance, or COLD.
+    uint32_t access(uint32_t block, std::vector<uint32_t> &last_use);
+
+private:
+    std::vector<uint32_t> tree;  // Fenwick tree over slots 1..tree.size()
+    std::vector<uint32_t> slots; // block at each used slot, COLD once it moved on
+    uint32_t used = 0;
+    uint32_t live = 0;
+
+    void add(uint32_t slot, int32_t delta);
+    uint32_t prefix(uint32_t slot) const;
+    void compact(std::vector<uint32_t> &last_use);
+};
+
+// Run the analysis for every -b value on up to `jobs` threads, and write
+// each core's and the total misses for every -s and -E combination as CSV
+int runStackDistance(const SimulatorConfig &base, const std::vector<TraceReader> &traces,
+                     const std::vector<int> &set_bits, const std::vector<int> &assocs, const std::vector<int> &block_bits,
+                     int jobs, const std::string &outfilename);
+
+#endif
@@ -0,0 +1,112 @@
+#include "sweep.hpp"
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+
+bool parseValueList(const char *arg, std::vector<int> &values)
+{
+    values.clear();
+    const char *p = arg;
+    while (*p)
+    {
+        char *next;
+        long lo = strtol(p, &next, 10);
+        if (next == p)
+            return false;
+        long hi = lo;
+        p = next;
+        if (*p == '-')
+        {
+            hi = strtol(p + 1, &next, 10);
+            if (next == p + 1 || hi < lo)
+                return false;
+            p = next;
+        }
+        for (long v = lo; v <= hi; ++v)
+            values.push_back((int)v);
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return false;
+    }
+    return !values.empty();
+}
+
+static SweepResult collectResult(const Simulator &sim)
+{
+    SweepResult r = SweepResult();
+    for (int i = 0; i < sim.num_cores; ++i)
+    {
+        r.instructions += sim.caches[i].read_count + sim.caches[i].write_count;
+        r.misses += sim.caches[i].miss_count;
+        r.evictions += sim.caches[i].eviction_count;
+        r.writebacks += sim.caches[i].writeback_count;
+        r.invalidations += sim.caches[i].invalidation_count;
+    }
+    r.data_traffic = sim.global_stats.bus_data_traffic;
+    r.writeback_cycles = sim.global_stats.writeback_cycles;
+    r.bus_transactions = sim.bus_transactions;
+    r.max_cycles = sim.global_stats.total_cycles;
+    return r;
+}
+
+int runSweep(const SimulatorConfig &base, const std::vector<TraceReader> &traces,
+             const std::vector<int> &set_bits, const std::vector<int> &assocs, const std::vector<int> &block_bits,
+             const std::vector<CoherenceProtocol> &protocols, int jobs, const std::string &outfilename)
+{
+    std::vector<SweepPoint> points;
+    for (int s : set_bits)
+        for (int e : assocs)
+            for (int b : block_bits)
+                for (CoherenceProtocol protocol : protocols)
+                    points.push_back({s, e, b, protocol});
+    if (jobs < 1)
+        jobs = 1;
+    if ((size_t)jobs > points.size())
+        jobs = points.size();
+
+    std::cout << "Sweeping " << points.size() << " configurations on " << jobs << " threads.\n";
+    std::cout.flush();
+
+    // Each thread claims the next unsimulated point until none are left
+    std::vector<SweepResult> results(points.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < points.size(); i = next++)
+        {
+            SimulatorConfig config = base;
+            config.set_index_bits = points[i].set_index_bits;
+            config.assoc = points[i].assoc;
+            config.block_bits = points[i].block_bits;
+            config.protocol = points[i].protocol;
+            Simulator sim(config);
+            sim.shareTraces(traces);
+            sim.run();
+            results[i] = collectResult(sim);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < jobs; ++t)
+        threads.emplace_back(worker);
+    for (auto &t : threads)
+        t.join();
+
+    std::ofstream outfile(outfilename);
+    outfile << "set_index_bits,assoc,block_bits,protocol,cache_kb,instructions,misses,miss_rate,evictions,writebacks,"
+               "invalidations,bus_transactions,data_traffic_bytes,writeback_cycles,max_cycles\n";
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        const SweepPoint &p = points[i];
+        const SweepResult &r = results[i];
+        outfile << p.set_index_bits << "," << p.assoc << "," << p.block_bits << "," << coherenceProtocolName(p.protocol) << ","
+                << std::fixed << std::setprecision(2) << ((1 << p.set_index_bits) * p.assoc * (1 << p.block_bits)) / 1024.0 << ","
+                << r.instructions << "," << r.misses << ","
+                << std::setprecision(5) << (r.instructions ? (double)r.misses / r.instructions * 100 : 0.0) << ","
+                << r.evictions << "," << r.writebacks << "," << r.invalidations << ","
+                << r.bus_transactions << "," << r.data_traffic << "," << r.writeback_cycles << "," << r.max_cycles << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "simulator.hpp"
+
+// One cache geometry and protocol in a parameter sweep
+struct SweepPoint {
+    int set_index_bits;
+    int assoc;
+    int block_bits;
+    CoherenceProtocol protocol;
+};
+
+// Totals over all cores for one sweep point
+struct SweepResult {
+    uint64_t instructions;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t invalidations;
+    uint64_t data_traffic;
+    uint64_t writeback_cycles;
+    uint64_t bus_transactions;
+    uint64_t max_cycles;
+};
+
+// Parse a -s/-E/-b argument: a single value "6", a range "4-8" or a list
+// "1,2,4,8" (list items may themselves be ranges). False on bad syntax.
+bool parseValueList(const char *arg, std::vector<int> &values);
+
+// Run every combination of the given values, each as its own Simulator built
+// from base, on up to `jobs` threads at once, and write one CSV row per point
+// to outfilename. The traces are opened once by the caller and read
+// concurrently by every simulation.
+int runSweep(const SimulatorConfig &base, const std::vector<TraceReader> &traces,
+             const std::vector<int> &set_bits, const std::vector<int> &assocs, const std::vector<int> &block_bits,
+             const std::vector<CoherenceProtocol> &protocols, int jobs, const std::string &outfilename);
+
+#endif
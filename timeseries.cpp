@@ -0,0 +1,137 @@
+#include "timeseries.hpp"
+#include "simulator.hpp"
+#include <iomanip>
+
+static void takeSnapshot(const Simulator &sim, CounterSnapshot &s)
+{
+    s.cycle = sim.current_cycle;
+    s.bus_busy_cycles = sim.global_stats.bus_busy_cycles;
+    s.bus_transactions = sim.bus_transactions;
+    s.bus_data_traffic = sim.global_stats.bus_data_traffic;
+    s.invalidations = sim.global_stats.invalidations;
+    s.references.resize(sim.num_cores);
+    s.misses.resize(sim.num_cores);
+    s.core_invalidations.resize(sim.num_cores);
+    s.writebacks.resize(sim.num_cores);
+    s.idle_cycles.resize(sim.num_cores);
+    s.bus_wait_cycles.resize(sim.num_cores);
+    for (int i = 0; i < sim.num_cores; ++i)
+    {
+        const Cache &cache = sim.caches[i];
+        s.references[i] = cache.read_count + cache.write_count;
+        s.misses[i] = cache.miss_count;
+        s.core_invalidations[i] = cache.invalidation_count;
+        s.writebacks[i] = cache.writeback_count;
+        s.idle_cycles[i] = cache.idle_cycles;
+        s.bus_wait_cycles[i] = cache.bus_wait_cycles;
+    }
+}
+
+static uint64_t sum(const std::vector<uint64_t> &values)
+{
+    uint64_t total = 0;
+    for (uint64_t v : values)
+        total += v;
+    return total;
+}
+
+static void writeRow(Simulator &sim)
+{
+    TimeSeries &ts = *sim.timeseries;
+    CounterSnapshot now;
+    takeSnapshot(sim, now);
+    const CounterSnapshot &last = ts.last;
+    uint64_t cycles = now.cycle - last.cycle;
+    uint64_t references = sum(now.references) - sum(last.references);
+    uint64_t misses = sum(now.misses) - sum(last.misses);
+
+    std::ostream &out = ts.out;
+    out << now.cycle << "," << sum(now.references) << "," << cycles << "," << references << "," << misses << ","
+        << std::fixed << std::setprecision(4) << (references ? (double)misses / references : 0.0) << ","
+        << now.bus_transactions - last.bus_transactions << ","
+        << (cycles ? (double)(now.bus_busy_cycles - last.bus_busy_cycles) / cycles : 0.0) << ","
+        << std::setprecision(2) << (cycles ? (double)ts.depth_cycles / cycles : 0.0) << "," << ts.max_depth << ","
+        << ts.max_inflight << "," << now.invalidations - last.invalidations << ","
+        << sum(now.writebacks) - sum(last.writebacks) << "," << now.bus_data_traffic - last.bus_data_traffic;
+    for (int i = 0; i < sim.num_cores; ++i)
+    {
+        out << "," << now.references[i] - last.references[i] << "," << now.misses[i] - last.misses[i] << ","
+            << now.core_invalidations[i] - last.core_invalidations[i] << "," << now.writebacks[i] - last.writebacks[i] << ","
+            << now.idle_cycles[i] - last.idle_cycles[i] << "," << now.bus_wait_cycles[i] - last.bus_wait_cycles[i];
+    }
+    out << "\n";
+
+    ts.last = now;
+    ts.depth_cycles = 0;
+    ts.max_depth = 0;
+    ts.max_inflight = sim.memory_inflight.size();
+}
+
+bool openTimeSeries(Simulator &sim, const std::string &filename)
+{
+    sim.timeseries.reset(new TimeSeries);
+    TimeSeries &ts = *sim.timeseries;
+    ts.out.open(filename);
+    if (!ts.out)
+    {
+        sim.timeseries.reset();
+        return false;
+    }
+    ts.next = sim.config.timeseries.interval;
+    takeSnapshot(sim, ts.last);
+    ts.out << "cycle,references_total,cycles,references,misses,miss_rate,bus_transactions,bus_utilization,"
+              "avg_queue_depth,max_queue_depth,max_fills_in_flight,invalidations,writebacks,bus_traffic_bytes";
+    for (int i = 0; i < sim.num_cores; ++i)
+    {
+        ts.out << ",core" << i << "_references,core" << i << "_misses,core" << i << "_invalidations,core" << i
+               << "_writebacks,core" << i << "_idle_cycles,core" << i << "_bus_wait_cycles";
+    }
+    ts.out << "\n";
+    return true;
+}
+
+void updateTimeSeries(Simulator &sim)
+{
+    TimeSeries &ts = *sim.timeseries;
+    // Requests waiting for the bus: queued on the split bus, or cores
+    // waiting for the blocking bus to free up. They cannot change during the
+    // cycles since the last update without one, so the depth held throughout.
+    uint64_t depth = sim.bus_queue.size();
+    for (const Cache &cache : sim.caches)
+        depth += cache.bus_waiting;
+    ts.depth_cycles += depth * (sim.current_cycle - ts.last_update);
+    ts.last_update = sim.current_cycle;
+    if (depth > ts.max_depth)
+        ts.max_depth = depth;
+    if (sim.memory_inflight.size() > ts.max_inflight)
+        ts.max_inflight = sim.memory_inflight.size();
+
+    uint64_t position = sim.current_cycle;
+    if (sim.config.timeseries.unit == SAMPLE_REFERENCES)
+    {
+        position = 0;
+        for (const Cache &cache : sim.caches)
+            position += cache.read_count + cache.write_count;
+    }
+    if (position < ts.next)
+        return;
+    writeRow(sim);
+    uint64_t interval = sim.config.timeseries.interval;
+    ts.next = position - position % interval + interval;
+}
+
+void finishTimeSeries(Simulator &sim)
+{
+    TimeSeries &ts = *sim.timeseries;
+    if (sim.current_cycle > ts.last.cycle)
+        writeRow(sim);
+    ts.out.flush();
+}
+
+uint32_t cyclesToNextSample(const Simulator &sim)
+{
+    if (!sim.timeseries || sim.config.timeseries.unit != SAMPLE_CYCLES)
+        return UINT32_MAX;
+    uint64_t left = sim.timeseries->next - sim.current_cycle;
+    return left < UINT32_MAX ? (uint32_t)left : UINT32_MAX;
+}
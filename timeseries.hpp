@@ -0,0 +1,58 @@
+#ifndef TIMESERIES_HPP
+#define TIMESERIES_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+// Time series of the counters (--timeseries, snooping bus only). Every
+// `interval` cycles, or once every `interval` more references are done, one
+// CSV row is streamed out with what happened since the previous row:
+// references, misses and miss rate, bus transactions, bus utilization (the
+// share of the interval the bus was held), the average and peak number of
+// requests waiting for the bus, memory fills in flight, invalidations,
+// writebacks and bus traffic, then each core's own references, misses,
+// invalidations, writebacks, idle cycles and bus wait cycles. Nothing is kept but the
+// counters of the previous row, so any run length can be sampled.
+
+enum SampleUnit { SAMPLE_CYCLES, SAMPLE_REFERENCES };
+
+struct TimeSeriesConfig {
+    uint64_t interval = 0; // 0 disables the time series
+    SampleUnit unit = SAMPLE_CYCLES;
+};
+
+// The counters a row is the difference of
+struct CounterSnapshot {
+    uint64_t cycle = 0;
+    uint64_t bus_busy_cycles = 0;
+    uint64_t bus_transactions = 0;
+    uint64_t bus_data_traffic = 0;
+    uint64_t invalidations = 0;
+    std::vector<uint64_t> references, misses, core_invalidations, writebacks, idle_cycles, bus_wait_cycles;
+};
+
+struct TimeSeries {
+    std::ofstream out;
+    uint64_t next = 0;            // cycle or reference count of the next row
+    uint64_t depth_cycles = 0;    // bus queue depth summed over the interval's cycles
+    uint64_t max_depth = 0;
+    uint64_t max_inflight = 0;
+    uint64_t last_update = 0;     // cycle of the last update
+    CounterSnapshot last;
+};
+
+struct Simulator;
+
+// Start the series in filename and write the CSV header; false if it cannot be written
+bool openTimeSeries(Simulator &sim, const std::string &filename);
+// Account the cycles since the last call, and write a row if the interval is over.
+// Called after every simulated cycle and every skip ahead.
+void updateTimeSeries(Simulator &sim);
+// Write the last, partial interval
+void finishTimeSeries(Simulator &sim);
+// Cycles the simulation may skip before the next row is due (UINT32_MAX if unbounded)
+uint32_t cyclesToNextSample(const Simulator &sim);
+
+#endif
@@ -0,0 +1,427 @@
+#include "trace.hpp"
+#include "profile.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Consumed pages are released in chunks of this size to keep RSS bounded
+static const size_t RELEASE_CHUNK = 64 << 20;
+
+static inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+bool parseTraceLine(const char *&p, const char *end, TraceRef &ref)
+{
+    const char *q = p;
+    while (q < end && (*q == ' ' || *q == '\t' || *q == '\r'))
+        q++;
+    if (q == end || *q == '\n')
+        return false;
+    ref.op = *q++;
+
+    while (q < end && (*q == ' ' || *q == '\t'))
+        q++;
+    if (q + 1 < end && q[0] == '0' && (q[1] == 'x' || q[1] == 'X'))
+        q += 2;
+
+    uint64_t addr = 0;
+    int digits = 0;
+    int v;
+    while (q < end && (v = hexValue(*q)) >= 0)
+    {
+        addr = (addr << 4) | v;
+        if (addr > UINT32_MAX)
+            return false;
+        q++;
+        digits++;
+    }
+    if (digits == 0)
+        return false;
+    ref.addr = (uint32_t)addr;
+
+    // Anything after the address is ignored, as before
+    while (q < end && *q != '\n')
+        q++;
+    if (q < end)
+        q++;
+    p = q;
+    return true;
+}
+
+std::string traceFileName(const std::string &prefix, int core)
+{
+    return prefix + "_proc" + std::to_string(core) + ".trace";
+}
+
+std::string binaryTraceFileName(const std::string &prefix, int core)
+{
+    return prefix + "_proc" + std::to_string(core) + ".btrace";
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+bool BinaryTraceWriter::open(const std::string &name)
+{
+    out.open(name, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(header.magic));
+    header.version = BINARY_TRACE_VERSION;
+    header.count = 0;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    buf.clear();
+    buf.reserve(1 << 20);
+    last = 0;
+    return bool(out);
+}
+
+void BinaryTraceWriter::add(const TraceRef &ref)
+{
+    // 33 bits of payload: zigzagged 32-bit delta plus the write flag
+    uint64_t v = ((uint64_t)zigzag((int32_t)(ref.addr - last)) << 1) | (ref.op == 'W');
+    last = ref.addr;
+    while (v >= 0x80)
+    {
+        buf.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((char)v);
+    header.count++;
+    if (buf.size() >= (1 << 20) - 8)
+    {
+        out.write(buf.data(), buf.size());
+        buf.clear();
+    }
+}
+
+bool BinaryTraceWriter::close()
+{
+    out.write(buf.data(), buf.size());
+    buf.clear();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.close();
+    return bool(out);
+}
+
+bool writeBinaryTrace(TraceReader &in, const std::string &outname)
+{
+    BinaryTraceWriter writer;
+    if (!writer.open(outname))
+        return false;
+    for (; !in.done(); in.advance())
+        writer.add(in.current());
+    return writer.close();
+}
+
+// Parser thread and ring of a pipelined reader. head and tail count
+// references ever read and written; each side publishes its own counter
+// every PIPELINE_BATCH references and keeps a private copy of the other's,
+// so the shared cache lines move only once per batch.
+static const uint64_t PIPELINE_BATCH = 256;
+
+struct TracePipeline {
+    std::vector<TraceRef> ring;
+    uint64_t mask;
+    TraceReader source; // the parser's cursor, owning the mapping
+    std::thread parser;
+    // Padding keeps what each side writes on cache lines of its own
+    std::atomic<uint64_t> head{0};     // published by the simulator
+    char pad0[64];
+    std::atomic<uint64_t> tail{0};     // published by the parser
+    std::atomic<bool> finished{false}; // tail is final
+    std::atomic<bool> stop{false};     // the reader is closing
+    char pad1[64];
+    uint64_t read = 0;                 // simulator side
+    uint64_t available = 0;            // tail as last seen by the simulator
+};
+
+// Spin briefly, then give the CPU away: with fewer host cores than threads
+// the other side cannot run otherwise
+static void backOff(int &spins)
+{
+    if (++spins < 64)
+    {
+#if defined(__SSE2__)
+        _mm_pause();
+#endif
+    }
+    else
+    {
+        std::this_thread::yield();
+    }
+}
+
+static void runParser(TracePipeline &p)
+{
+    uint64_t capacity = p.ring.size();
+    uint64_t write = 0, limit = capacity;
+    // The reader already holds the current reference; the parser starts after it
+    for (p.source.advance(); !p.source.done(); p.source.advance())
+    {
+        if (write == limit)
+        {
+            p.tail.store(write, std::memory_order_release);
+            int spins = 0;
+            while ((limit = p.head.load(std::memory_order_acquire) + capacity) == write)
+            {
+                if (p.stop.load(std::memory_order_relaxed))
+                    return;
+                backOff(spins);
+            }
+        }
+        p.ring[write++ & p.mask] = p.source.current();
+        if (write % PIPELINE_BATCH == 0)
+            p.tail.store(write, std::memory_order_release);
+    }
+    p.tail.store(write, std::memory_order_release);
+    p.finished.store(true, std::memory_order_release);
+}
+
+// Next reference from the ring; false once the parser has finished and it is empty
+static bool popReference(TracePipeline &p, TraceRef &ref)
+{
+    if (p.read == p.available)
+    {
+        int spins = 0;
+        while ((p.available = p.tail.load(std::memory_order_acquire)) == p.read)
+        {
+            if (p.finished.load(std::memory_order_acquire))
+            {
+                p.available = p.tail.load(std::memory_order_acquire);
+                if (p.available == p.read)
+                    return false;
+                break;
+            }
+            backOff(spins);
+        }
+    }
+    ref = p.ring[p.read++ & p.mask];
+    if (p.read % PIPELINE_BATCH == 0)
+        p.head.store(p.read, std::memory_order_release);
+    return true;
+}
+
+void TraceReader::startPipeline(size_t capacity)
+{
+    if (eof)
+        return;
+    pipeline.reset(new TracePipeline);
+    TracePipeline &p = *pipeline;
+    p.ring.resize(capacity);
+    p.mask = capacity - 1;
+    p.source.share(*this);
+    p.source.owns_mapping = true;
+    owns_mapping = false;
+    p.parser = std::thread(runParser, std::ref(p));
+}
+
+TraceReader::TraceReader()
+{
+}
+
+TraceReader::~TraceReader()
+{
+    close();
+}
+
+bool TraceReader::open(const std::string &name)
+{
+    close();
+    filename = name;
+    int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    size = st.st_size;
+    if (size > 0)
+    {
+        void *m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        madvise(m, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(m);
+    }
+    ::close(fd);
+    pos = released = data;
+    end = data + size;
+    eof = false;
+    binary = false;
+    last_addr = 0;
+    if (size >= sizeof(BinaryTraceHeader) && memcmp(data, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0)
+    {
+        BinaryTraceHeader header;
+        memcpy(&header, data, sizeof(header));
+        if (header.version != BINARY_TRACE_VERSION)
+        {
+            std::cerr << "Unsupported binary trace version " << header.version << " in " << filename << "\n";
+            exit(1);
+        }
+        binary = true;
+        pos += sizeof(header);
+    }
+    advance();
+    return true;
+}
+
+void TraceReader::share(const TraceReader &other)
+{
+    close();
+    filename = other.filename;
+    binary = other.binary;
+    last_addr = other.last_addr;
+    data = other.data;
+    pos = other.pos;
+    end = other.end;
+    released = other.released;
+    size = other.size;
+    ref = other.ref;
+    eof = other.eof;
+    owns_mapping = false;
+}
+
+void TraceReader::seek(const TraceReader &other)
+{
+    last_addr = other.last_addr;
+    pos = other.pos;
+    ref = other.ref;
+    eof = other.eof;
+    budget = other.budget;
+    held = other.held;
+}
+
+void TraceReader::holdAfter(uint64_t n)
+{
+    resume();
+    budget = n;
+    if (n == 0 && !eof)
+    {
+        held = true;
+        eof = true;
+    }
+}
+
+void TraceReader::resume()
+{
+    if (held)
+        eof = false;
+    held = false;
+    budget = 0;
+}
+
+void TraceReader::close()
+{
+    if (pipeline)
+    {
+        // The parser's cursor unmaps the file once the thread is gone
+        pipeline->stop = true;
+        pipeline->parser.join();
+        pipeline.reset();
+    }
+    if (data && owns_mapping)
+        munmap(const_cast<char *>(data), size);
+    owns_mapping = true;
+    data = pos = end = released = nullptr;
+    size = 0;
+    eof = true;
+}
+
+void TraceReader::advance()
+{
+    PROFILE_SCOPE(PHASE_PARSE);
+    if (pipeline)
+    {
+        if (!popReference(*pipeline, ref))
+        {
+            eof = true;
+            return;
+        }
+    }
+    else if (pos == end)
+    {
+        eof = true;
+        return;
+    }
+    else if (binary)
+    {
+        uint64_t v = 0;
+        int shift = 0;
+        while (true)
+        {
+            if (pos == end || shift > 32)
+            {
+                std::cerr << "Truncated binary trace " << filename << "\n";
+                exit(1);
+            }
+            unsigned char b = *pos++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            shift += 7;
+            if (!(b & 0x80))
+                break;
+        }
+        ref.op = (v & 1) ? 'W' : 'R';
+        last_addr += unzigzag((uint32_t)(v >> 1));
+        ref.addr = last_addr;
+    }
+    else
+    {
+        const char *line = pos;
+        if (!parseTraceLine(pos, end, ref))
+        {
+            const char *line_end = line;
+            while (line_end < end && *line_end != '\n')
+                line_end++;
+            std::cerr << "Invalid trace entry in " << filename << ": " << std::string(line, line_end) << "\n";
+            exit(1);
+        }
+    }
+
+    // Shared mappings are left alone, other readers may still need the pages
+    if (owns_mapping && (size_t)(pos - released) >= RELEASE_CHUNK)
+    {
+        size_t page = sysconf(_SC_PAGESIZE);
+        const char *upto = data + ((pos - data) / page) * page;
+        madvise(const_cast<char *>(released), upto - released, MADV_DONTNEED);
+        released = upto;
+    }
+    if (budget && --budget == 0)
+    {
+        held = true;
+        eof = true;
+    }
+}
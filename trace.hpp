@@ -0,0 +1,111 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <vector>
+#include <memory>
+
+// One memory reference from a trace file
+struct TraceRef {
+    char op;
+    uint32_t addr;
+};
+
+// Packed binary traces (<prefix>_procN.btrace): a 16-byte header followed by
+// one LEB128 varint per reference holding (zigzag(addr delta) << 1) | is_write
+static const char BINARY_TRACE_MAGIC[4] = {'L', '1', 'B', 'T'};
+static const uint32_t BINARY_TRACE_VERSION = 1;
+
+struct BinaryTraceHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;  // number of references
+};
+
+// References a pipelined reader buffers between its parser thread and the
+// simulator (8 bytes each)
+static const size_t PIPELINE_RING = 1 << 16;
+
+struct TracePipeline;
+
+// Streams references out of a memory-mapped trace file, text or binary.
+// References are decoded lazily, one ahead of the simulator, so memory use
+// does not grow with the trace length. A pipelined reader decodes on a
+// thread of its own instead, ahead of the simulator, into a fixed-size ring.
+struct TraceReader {
+    std::string filename;
+    bool binary = false;
+    uint32_t last_addr = 0;     // previous address, for binary delta decoding
+    const char *data = nullptr; // start of the mapping
+    const char *pos = nullptr;  // next unparsed byte
+    const char *end = nullptr;
+    const char *released = nullptr; // pages before this were handed back to the OS
+    size_t size = 0;
+    TraceRef ref;               // current reference, valid while !done()
+    bool eof = true;
+    bool owns_mapping = true;   // false for cursors created with share()
+    uint64_t budget = 0;        // references left before the reader holds, 0 for no limit
+    bool held = false;          // done() only because the budget ran out
+    std::unique_ptr<TracePipeline> pipeline; // parser thread and ring, once started
+
+    TraceReader();
+    ~TraceReader();
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    // Map the file and decode its first reference; false if it cannot be opened.
+    // Files starting with the binary magic are read as packed traces.
+    bool open(const std::string &name);
+    void close();
+    // Start a new cursor at other's current position, reading other's mapping.
+    // other must stay open while this reader is in use.
+    void share(const TraceReader &other);
+    // Move a cursor made with share() to other's current position
+    void seek(const TraceReader &other);
+
+    // Report done() once n more references are consumed (at once for 0),
+    // until resume(); sampled simulation runs the cores in slices this way
+    void holdAfter(uint64_t n);
+    void resume();
+
+    bool done() const { return eof; }
+    const TraceRef &current() const { return ref; }
+    // Move on to the next reference
+    void advance();
+
+    // Parse the rest of the trace on a parser thread, which hands references
+    // over through a lock-free single-producer, single-consumer ring of
+    // `capacity` entries (a power of two) and blocks while it is full. The
+    // parser takes over the mapping and releases its consumed pages. A
+    // pipelined reader cannot be shared, seeked or checkpointed.
+    void startPipeline(size_t capacity = PIPELINE_RING);
+};
+
+// Parse one "R 0x1234abcd" line starting at p, stopping at end.
+// On success fills ref, sets p past the line and returns true.
+bool parseTraceLine(const char *&p, const char *end, TraceRef &ref);
+
+// Path of the text and packed binary trace for one core
+std::string traceFileName(const std::string &prefix, int core);
+std::string binaryTraceFileName(const std::string &prefix, int core);
+
+// Writes a packed binary trace one reference at a time
+struct BinaryTraceWriter {
+    std::ofstream out;
+    BinaryTraceHeader header;
+    std::vector<char> buf;
+    uint32_t last = 0;
+
+    bool open(const std::string &name);
+    void add(const TraceRef &ref);
+    // Flush and fill in the reference count; false on a write error
+    bool close();
+};
+
+// Convert a whole trace (text or binary) to the packed binary format
+bool writeBinaryTrace(TraceReader &in, const std::string &outname);
+
+#endif
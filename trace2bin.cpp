@@ -0,0 +1,36 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "trace.hpp"
+
+// Convert <prefix>_procN.trace text traces into packed <prefix>_procN.btrace
+// files, which L1simulate picks up automatically
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: ./trace2bin <trace_prefix> [num_cores]\n";
+        return 1;
+    }
+    std::string prefix = argv[1];
+    int cores = argc > 2 ? atoi(argv[2]) : 4;
+
+    for (int i = 0; i < cores; ++i)
+    {
+        std::string inname = traceFileName(prefix, i);
+        std::string outname = binaryTraceFileName(prefix, i);
+        TraceReader in;
+        if (!in.open(inname))
+        {
+            std::cerr << "Cannot open " << inname << "\n";
+            return 1;
+        }
+        if (!writeBinaryTrace(in, outname))
+        {
+            std::cerr << "Cannot write " << outname << "\n";
+            return 1;
+        }
+        std::cout << inname << " -> " << outname << "\n";
+    }
+    return 0;
+}